@@ -22,13 +22,21 @@ HEADERS += \
     src/LoggerPlugin.h \
     src/LoggerUtil.h \
     src/SimpleLogger.h \
-    src/CSVLogger.h
+    src/CSVLogger.h \
+    src/CSVLogIndex.h \
+    src/CSVCodec.h \
+    src/LogReader.h \
+    src/LogSession.h
 
 SOURCES += \
     src/LoggerPlugin.cpp \
     src/LoggerUtil.cpp \
     src/SimpleLogger.cpp \
-    src/CSVLogger.cpp
+    src/CSVLogger.cpp \
+    src/CSVLogIndex.cpp \
+    src/CSVCodec.cpp \
+    src/LogReader.cpp \
+    src/LogSession.cpp
 
 OTHER_FILES += qmldir
 
@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file CSVCodec.cpp
+ * @brief Source for low level encoding and decoding of CSV log fields
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#include "CSVCodec.h"
+
+#include <QDateTime>
+#include <QtAlgorithms>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define QMLLOGGER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define QMLLOGGER_NEON
+#endif
+
+namespace QMLLogger{
+
+namespace{
+
+/**
+ * @brief Powers of ten that are exact in a double
+ */
+const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * @brief Finds the first occurrence of any of the given characters, 16 bytes at a time if SIMD is available
+ *
+ * @param it Beginning of the range to search
+ * @param end End of the range to search
+ * @param a First character to look for
+ * @param b Second character to look for
+ * @param c Third character to look for
+ * @param d Fourth character to look for
+ * @return First occurrence, end if there is none
+ */
+inline const char* findAny(const char* it, const char* end, char a, char b, char c, char d){
+#if defined(QMLLOGGER_SSE2) || defined(QMLLOGGER_NEON)
+    const char* begin = it;
+#endif
+#if defined(QMLLOGGER_SSE2)
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    const __m128i vd = _mm_set1_epi8(d);
+    while(end - it >= 16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*)it);
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(chunk, vc), _mm_cmpeq_epi8(chunk, vd)));
+        quint32 mask = (quint32)_mm_movemask_epi8(matches);
+        if(mask)
+            return it + qCountTrailingZeroBits(mask);
+        it += 16;
+    }
+
+    //Finish with an overlapping load instead of byte by byte if the range is long enough
+    if(it < end && end - begin >= 16){
+        const char* last = end - 16;
+        __m128i chunk = _mm_loadu_si128((const __m128i*)last);
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(chunk, vc), _mm_cmpeq_epi8(chunk, vd)));
+        quint32 mask = (quint32)_mm_movemask_epi8(matches) >> (it - last);
+        return mask ? it + qCountTrailingZeroBits(mask) : end;
+    }
+#elif defined(QMLLOGGER_NEON)
+    const uint8x16_t va = vdupq_n_u8((uint8_t)a);
+    const uint8x16_t vb = vdupq_n_u8((uint8_t)b);
+    const uint8x16_t vc = vdupq_n_u8((uint8_t)c);
+    const uint8x16_t vd = vdupq_n_u8((uint8_t)d);
+    while(end - it >= 16){
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)it);
+        uint8x16_t matches = vorrq_u8(vorrq_u8(vceqq_u8(chunk, va), vceqq_u8(chunk, vb)),
+                                      vorrq_u8(vceqq_u8(chunk, vc), vceqq_u8(chunk, vd)));
+
+        //Narrow to 4 bits per byte to get a 64-bit mask
+        quint64 mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+        if(mask)
+            return it + (qCountTrailingZeroBits(mask) >> 2);
+        it += 16;
+    }
+
+    //Finish with an overlapping load instead of byte by byte if the range is long enough
+    if(it < end && end - begin >= 16){
+        const char* last = end - 16;
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)last);
+        uint8x16_t matches = vorrq_u8(vorrq_u8(vceqq_u8(chunk, va), vceqq_u8(chunk, vb)),
+                                      vorrq_u8(vceqq_u8(chunk, vc), vceqq_u8(chunk, vd)));
+        quint64 mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0) >> (4*(it - last));
+        return mask ? it + (qCountTrailingZeroBits(mask) >> 2) : end;
+    }
+#endif
+    for(; it < end; it++)
+        if(*it == a || *it == b || *it == c || *it == d)
+            return it;
+    return end;
+}
+
+/**
+ * @brief Finds the first occurrence of either of the given characters outside of quoted fields
+ *
+ * @param it Beginning of the range to search, outside of a quoted field
+ * @param end End of the range to search
+ * @param a First character to look for
+ * @param b Second character to look for
+ * @return First occurrence outside of quotes, end if there is none
+ */
+inline const char* findUnquoted(const char* it, const char* end, char a, char b){
+    while(true){
+        it = findAny(it, end, a, b, '"', '"');
+        if(it == end || *it != '"')
+            return it;
+
+        //Doubled quotes inside a quoted field close and reopen it, which amounts to the same
+        const char* closing = (const char*)memchr(it + 1, '"', end - it - 1);
+        if(!closing)
+            return end;
+        it = closing + 1;
+    }
+}
+
+/**
+ * @brief Checks whether the quotes of a range are where fields begin and end, given whether it begins inside a quoted field
+ *
+ * @param it Beginning of the range
+ * @param end End of the range
+ * @param quoted Whether the range is assumed to begin inside a quoted field
+ * @return Whether every quote opens a field at its beginning or closes it at its end, doubled quotes included
+ */
+bool quotesFitFields(const char* it, const char* end, bool quoted){
+    const char* begin = it;
+    for(; (it = findAny(it, end, '"', '"', '"', '"')) < end; it++){
+        if(quoted){
+            const char* next = it + 1;
+            if(next < end && *next != ',' && *next != '\n' && *next != '\r' && *next != '"')
+                return false;
+        }
+        else if(it > begin){
+            char previous = it[-1];
+            if(previous != ',' && previous != '\n' && previous != '"' && !(previous == ' ' && it - begin >= 2 && it[-2] == ','))
+                return false;
+        }
+        quoted = !quoted;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a fixed number of decimal digits
+ *
+ * @param it Beginning of the digits
+ * @param count Number of digits
+ * @param value Set to the parsed value
+ * @return Whether all characters were digits
+ */
+inline bool parseDigits(const char* it, int count, int* value){
+    *value = 0;
+    for(int i = 0; i < count; i++){
+        if(it[i] < '0' || it[i] > '9')
+            return false;
+        *value = *value*10 + (it[i] - '0');
+    }
+    return true;
+}
+
+}
+
+double CSVCodec::parseDouble(const char* begin, const char* end, bool* ok){
+    while(begin < end && *begin == ' ')
+        begin++;
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\r'))
+        end--;
+
+    //Fast path: [-]digits[.digits] with a mantissa and power of ten that are both exact in a double
+    const char* it = begin;
+    bool negative = false;
+    if(it < end && (*it == '-' || *it == '+'))
+        negative = *it++ == '-';
+    quint64 mantissa = 0;
+    int digits = 0;
+    int decimals = 0;
+    while(it < end && *it >= '0' && *it <= '9'){
+        mantissa = mantissa*10 + (*it++ - '0');
+        digits++;
+    }
+    if(it < end && *it == '.'){
+        it++;
+        while(it < end && *it >= '0' && *it <= '9'){
+            mantissa = mantissa*10 + (*it++ - '0');
+            digits++;
+            decimals++;
+        }
+    }
+    if(it == end && digits > 0 && digits <= 15 && decimals <= 22){
+        if(ok)
+            *ok = true;
+        double value = (double)mantissa/powersOfTen[decimals];
+        return negative ? -value : value;
+    }
+
+    //Slow path: exponents, nan, inf, long mantissas...
+    return QByteArray(begin, int(end - begin)).toDouble(ok);
+}
+
+const char* CSVCodec::findField(const char* begin, const char* end, int field, const char** fieldEnd){
+    for(int i = 0; i < field; i++){
+        const char* comma = findUnquoted(begin, end, ',', ',');
+        if(comma == end)
+            return nullptr;
+        begin = comma + 1;
+        if(begin < end && *begin == ' ')
+            begin++;
+    }
+    if(fieldEnd)
+        *fieldEnd = findUnquoted(begin, end, ',', ',');
+    return begin;
+}
+
+const char* CSVCodec::findDelimiter(const char* begin, const char* end){
+    return findUnquoted(begin, end, ',', '\n');
+}
+
+const char* CSVCodec::findRowEnd(const char* begin, const char* end){
+    return findUnquoted(begin, end, '\n', '\n');
+}
+
+const char* CSVCodec::findLastRowEnd(const char* begin, const char* end, bool atRowStart){
+    bool quoted = !atRowStart && !quotesFitFields(begin, end, false) && quotesFitFields(begin, end, true);
+    const char* rowEnd = end;
+    for(const char* it = begin; (it = findAny(it, end, '"', '\n', '\n', '\n')) < end; it++){
+        if(*it == '"')
+            quoted = !quoted;
+        else if(!quoted)
+            rowEnd = it;
+    }
+    return rowEnd;
+}
+
+void CSVCodec::quoteField(QByteArray& out, int from){
+    const char* end = out.constData() + out.size();
+    const char* special = findAny(out.constData() + from, end, ',', '"', '\r', '\n');
+    if(special == end)
+        return;
+
+    //Grow by the enclosing quotes and one byte per quote to double, then shift backwards in place
+    int quotes = 0;
+    for(const char* it = special; (it = findAny(it, end, '"', '"', '"', '"')) < end; it++)
+        quotes++;
+    int oldSize = out.size();
+    out.resize(oldSize + 2 + quotes);
+    char* first = out.data() + from;
+    char* src = out.data() + oldSize;
+    char* dst = out.data() + out.size();
+    *--dst = '"';
+    while(src > first){
+        char c = *--src;
+        *--dst = c;
+        if(c == '"')
+            *--dst = '"';
+    }
+    *--dst = '"';
+}
+
+void CSVCodec::escapeLineBreaks(QByteArray& out, int from){
+    const char* end = out.constData() + out.size();
+    const char* lineBreak = findAny(out.constData() + from, end, '\r', '\n', '\n', '\n');
+    if(lineBreak == end)
+        return;
+
+    int lineBreaks = 0;
+    for(const char* it = lineBreak; (it = findAny(it, end, '\r', '\n', '\n', '\n')) < end; it++)
+        lineBreaks++;
+    int breakOffset = int(lineBreak - out.constData());
+    int oldSize = out.size();
+    out.resize(oldSize + lineBreaks);
+    char* first = out.data() + breakOffset;
+    char* src = out.data() + oldSize;
+    char* dst = out.data() + out.size();
+    while(src > first){
+        char c = *--src;
+        if(c == '\n' || c == '\r'){
+            *--dst = c == '\n' ? 'n' : 'r';
+            *--dst = '\\';
+        }
+        else
+            *--dst = c;
+    }
+}
+
+void CSVCodec::appendUnquoted(QByteArray& out, const char* begin, const char* end){
+    if(end - begin < 2 || *begin != '"' || end[-1] != '"'){
+        out.append(begin, int(end - begin));
+        return;
+    }
+    begin++;
+    end--;
+    while(begin < end){
+        const char* quote = (const char*)memchr(begin, '"', end - begin);
+        const char* runEnd = quote ? quote + 1 : end;
+        out.append(begin, int(runEnd - begin));
+        begin = runEnd;
+        if(quote && begin < end && *begin == '"')
+            begin++;
+    }
+}
+
+bool CSVCodec::parseTimestamp(const char* begin, const char* end, qint64* msecs){
+    while(begin < end && *begin == ' ')
+        begin++;
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\r'))
+        end--;
+    qint64 length = end - begin;
+    if(length != 19 && length != 23)
+        return false;
+    if(begin[4] != '-' || begin[7] != '-' || begin[10] != ' ' || begin[13] != ':' || begin[16] != ':' || (length == 23 && begin[19] != '.'))
+        return false;
+
+    int year, month, day, hour, minute, second, millis = 0;
+    if(!parseDigits(begin, 4, &year) || !parseDigits(begin + 5, 2, &month) || !parseDigits(begin + 8, 2, &day) ||
+       !parseDigits(begin + 11, 2, &hour) || !parseDigits(begin + 14, 2, &minute) || !parseDigits(begin + 17, 2, &second) ||
+       (length == 23 && !parseDigits(begin + 20, 3, &millis)))
+        return false;
+    if(month < 1 || month > 12 || day < 1 || day > 31)
+        return false;
+
+    //Days since epoch of a proleptic Gregorian date, see http://howardhinnant.github.io/date_algorithms.html
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399)/400;
+    int yearOfEra = y - era*400;
+    int dayOfYear = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day - 1;
+    int dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+    qint64 days = (qint64)era*146097 + dayOfEra - 719468;
+
+    *msecs = ((days*24 + hour)*60 + minute)*60000 + second*1000 + millis;
+    return true;
+}
+
+void CSVCodec::appendDouble(QByteArray& out, double value, int precision){
+    precision = qBound(0, precision, 30);
+
+    //Fast path: scale to an integer and print its digits, unless the error of scaling could change the rounding
+    if(precision <= 15){
+        double scaled = std::fabs(value*powersOfTen[precision]);
+        if(scaled < 1099511627776.0){ //2^40, the scaling error is below 2^-13; false for NaN
+            double whole = std::floor(scaled);
+            double fraction = scaled - whole;
+            if(std::fabs(fraction - 0.5) > 1e-3){
+                quint64 digits = (quint64)whole + (fraction > 0.5);
+                char buffer[32];
+                char* end = buffer + sizeof(buffer);
+                char* it = end;
+                for(int i = 0; i < precision; i++){
+                    *--it = char('0' + digits%10);
+                    digits /= 10;
+                }
+                if(precision > 0)
+                    *--it = '.';
+                do{
+                    *--it = char('0' + digits%10);
+                    digits /= 10;
+                } while(digits > 0);
+                if(std::signbit(value))
+                    *--it = '-';
+                out.append(it, int(end - it));
+                return;
+            }
+        }
+    }
+
+    char buffer[352]; //Up to 309 integer digits, sign, point and 30 decimals
+    int length = qsnprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+    if(length <= 0)
+        return;
+    length = qMin(length, (int)sizeof(buffer) - 1);
+
+    //printf follows LC_NUMERIC, which QCoreApplication sets from the environment
+    for(int i = 0; i < length; i++)
+        if(buffer[i] == ',')
+            buffer[i] = '.';
+    out.append(buffer, length);
+}
+
+void CSVCodec::appendInteger(QByteArray& out, qint64 value){
+    char buffer[20];
+    char* end = buffer + sizeof(buffer);
+    char* it = end;
+    quint64 magnitude = value < 0 ? 0 - (quint64)value : (quint64)value;
+    do{
+        *--it = char('0' + magnitude%10);
+        magnitude /= 10;
+    } while(magnitude > 0);
+    if(value < 0)
+        *--it = '-';
+    out.append(it, int(end - it));
+}
+
+void CSVCodec::appendUtf8(QByteArray& out, QString const& string){
+    appendUtf8(out, string.utf16(), string.size());
+}
+
+void CSVCodec::appendUtf8(QByteArray& out, const ushort* utf16, int length){
+    const ushort* it = utf16;
+    const ushort* end = it + length;
+    int oldSize = out.size();
+    out.resize(oldSize + 3*length); //At most 3 bytes per UTF-16 code unit
+    uchar* dst = (uchar*)out.data() + oldSize;
+    while(it < end){
+        ushort c = *it++;
+        if(c < 0x80)
+            *dst++ = (uchar)c;
+        else if(c < 0x800){
+            *dst++ = (uchar)(0xC0 | (c >> 6));
+            *dst++ = (uchar)(0x80 | (c & 0x3F));
+        }
+        else if(QChar::isHighSurrogate(c) && it < end && QChar::isLowSurrogate(*it)){
+            uint u = QChar::surrogateToUcs4(c, *it++);
+            *dst++ = (uchar)(0xF0 | (u >> 18));
+            *dst++ = (uchar)(0x80 | ((u >> 12) & 0x3F));
+            *dst++ = (uchar)(0x80 | ((u >> 6) & 0x3F));
+            *dst++ = (uchar)(0x80 | (u & 0x3F));
+        }
+        else{
+            if(QChar::isSurrogate(c))
+                c = QChar::ReplacementCharacter;
+            *dst++ = (uchar)(0xE0 | (c >> 12));
+            *dst++ = (uchar)(0x80 | ((c >> 6) & 0x3F));
+            *dst++ = (uchar)(0x80 | (c & 0x3F));
+        }
+    }
+    out.resize(int(dst - (uchar*)out.data()));
+}
+
+TimestampFormatter::TimestampFormatter(){
+    cachedSecond = std::numeric_limits<qint64>::min();
+}
+
+void TimestampFormatter::append(QByteArray& out, qint64 msecs, bool millis){
+    qint64 second = msecs >= 0 ? msecs/1000 : (msecs - 999)/1000;
+    if(second != cachedSecond){
+        QByteArray text = QDateTime::fromMSecsSinceEpoch(second*1000).toString("yyyy-MM-dd HH:mm:ss").toLatin1();
+        memcpy(cachedText, text.constData(), qMin(text.size(), (int)sizeof(cachedText)));
+        cachedSecond = second;
+    }
+    out.append(cachedText, sizeof(cachedText));
+    if(millis){
+        int ms = int(msecs - second*1000);
+        char text[4] = { '.', char('0' + ms/100), char('0' + ms/10%10), char('0' + ms%10) };
+        out.append(text, sizeof(text));
+    }
+}
+
+}
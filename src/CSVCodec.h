@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file CSVCodec.h
+ * @brief Header for low level encoding and decoding of CSV log fields
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#ifndef CSVCODEC_H
+#define CSVCODEC_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+
+namespace QMLLogger{
+
+/**
+ * @brief Low level encoding and decoding of the fields of CSV logs, working on raw bytes without allocating.
+ */
+class CSVCodec {
+
+public:
+
+    /**
+     * @brief Parses a decimal floating point number, ignoring leading and trailing spaces
+     *
+     * Plain decimals with at most 15 significant digits, such as the ones written by CSVLogger, are converted exactly
+     * without going through the locale; anything else falls back to QByteArray::toDouble().
+     *
+     * @param begin Beginning of the field
+     * @param end End of the field
+     * @param ok If not null, set to whether the field is a valid number
+     * @return The parsed number, 0 if not valid
+     */
+    static double parseDouble(const char* begin, const char* end, bool* ok = nullptr);
+
+    /**
+     * @brief Finds the beginning of the given field in a line separated with `, `, skipping commas in quoted fields
+     *
+     * @param begin Beginning of the line
+     * @param end End of the line, excluding the newline
+     * @param field Index of the field to find
+     * @param fieldEnd If not null, set to the end of the found field
+     * @return Beginning of the field, null if the line doesn't have that many fields
+     */
+    static const char* findField(const char* begin, const char* end, int field, const char** fieldEnd = nullptr);
+
+    /**
+     * @brief Finds the first field delimiter, i.e comma or newline, 16 bytes at a time with SSE2 or NEON if available
+     *
+     * Delimiters inside quoted fields are skipped.
+     *
+     * @param begin Beginning of the range to search, outside of a quoted field
+     * @param end End of the range to search
+     * @return First delimiter in the range, end if there is none
+     */
+    static const char* findDelimiter(const char* begin, const char* end);
+
+    /**
+     * @brief Finds the newline that ends the row, skipping newlines inside quoted fields
+     *
+     * @param begin Beginning of the row
+     * @param end End of the range to search
+     * @return Newline ending the row, end if there is none
+     */
+    static const char* findRowEnd(const char* begin, const char* end);
+
+    /**
+     * @brief Finds the newline that ends the last complete row in a range that may begin inside a quoted field
+     *
+     * Unless the range is known to begin at a row, whether it begins inside a quoted field is inferred from its quotes:
+     * opening quotes follow a field separator or a line break and closing quotes are followed by one, which as soon
+     * as the range contains a quoted field only holds for one of both possibilities. A range without quotes is assumed
+     * to begin outside of quoted fields.
+     *
+     * @param begin Beginning of the range
+     * @param end End of the range
+     * @param atRowStart Whether the range is known to begin at the beginning of a row
+     * @return Newline ending the last complete row, end if there is none
+     */
+    static const char* findLastRowEnd(const char* begin, const char* end, bool atRowStart);
+
+    /**
+     * @brief Quotes the field at the end of the buffer as per RFC 4180 if it contains a comma, quote or line break
+     *
+     * The field is scanned 16 bytes at a time with SSE2 or NEON if available, and left untouched if it does not need
+     * quoting. Otherwise, it is enclosed in quotes and its quotes are doubled in place.
+     *
+     * @param out Buffer that ends with the field
+     * @param from Offset of the beginning of the field in the buffer
+     */
+    static void quoteField(QByteArray& out, int from);
+
+    /**
+     * @brief Replaces line breaks at the end of the buffer with `\n` and `\r` so that the text stays on one line
+     *
+     * @param out Buffer that ends with the text
+     * @param from Offset of the beginning of the text in the buffer
+     */
+    static void escapeLineBreaks(QByteArray& out, int from);
+
+    /**
+     * @brief Appends a field, removing its enclosing quotes and undoubling its quotes if it is quoted
+     *
+     * @param out Buffer to append to
+     * @param begin Beginning of the field, without leading spaces
+     * @param end End of the field, without trailing spaces
+     */
+    static void appendUnquoted(QByteArray& out, const char* begin, const char* end);
+
+    /**
+     * @brief Parses a timestamp written by CSVLogger, i.e `yyyy-MM-dd HH:mm:ss` or `yyyy-MM-dd HH:mm:ss.zzz`
+     *
+     * The time zone is not known, so the timestamp is converted as if it was UTC.
+     *
+     * @param begin Beginning of the field
+     * @param end End of the field
+     * @param msecs Set to the milliseconds since epoch
+     * @return Whether the field is a valid timestamp
+     */
+    static bool parseTimestamp(const char* begin, const char* end, qint64* msecs);
+
+    /**
+     * @brief Appends a floating point number with the given number of decimal places, like QString::number(value, 'f', precision)
+     *
+     * The decimal separator is always `.`, regardless of the locale. Does not allocate if `out` has enough capacity.
+     * Numbers that are below 2^40 once scaled by 10^precision, with precision at most 15, are rounded to an integer
+     * and printed digit by digit, which is much faster than printf; numbers too close to a rounding tie for that to be
+     * exact go through printf, so the result is always the same as printf's.
+     *
+     * @param out Buffer to append to
+     * @param value Number to append
+     * @param precision Number of decimal places, between 0 and 30
+     */
+    static void appendDouble(QByteArray& out, double value, int precision);
+
+    /**
+     * @brief Appends an integer in decimal, does not allocate if `out` has enough capacity
+     *
+     * @param out Buffer to append to
+     * @param value Integer to append
+     */
+    static void appendInteger(QByteArray& out, qint64 value);
+
+    /**
+     * @brief Appends a string encoded in UTF-8, does not allocate if `out` has enough capacity
+     *
+     * @param out Buffer to append to
+     * @param string String to append
+     */
+    static void appendUtf8(QByteArray& out, QString const& string);
+
+    /**
+     * @brief Appends UTF-16 text encoded in UTF-8, does not allocate if `out` has enough capacity
+     *
+     * @param out Buffer to append to
+     * @param utf16 UTF-16 code units to append
+     * @param length Number of code units
+     */
+    static void appendUtf8(QByteArray& out, const ushort* utf16, int length);
+
+};
+
+/**
+ * @brief Formats timestamps as `yyyy-MM-dd HH:mm:ss` or `yyyy-MM-dd HH:mm:ss.zzz` in local time.
+ *
+ * The text up to the seconds is cached and only rebuilt when the second changes, so that formatting does not allocate.
+ */
+class TimestampFormatter {
+
+public:
+
+    /**
+     * @brief Creates a new formatter with an empty cache
+     */
+    TimestampFormatter();
+
+    /**
+     * @brief Appends the given time
+     *
+     * @param out Buffer to append to
+     * @param msecs Time in milliseconds since epoch
+     * @param millis Whether to include milliseconds
+     */
+    void append(QByteArray& out, qint64 msecs, bool millis);
+
+private:
+
+    qint64 cachedSecond;    ///< Second since epoch of the cached text
+    char cachedText[19];    ///< Cached `yyyy-MM-dd HH:mm:ss` text
+
+};
+
+}
+
+#endif /* CSVCODEC_H */
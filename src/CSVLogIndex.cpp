@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file CSVLogIndex.cpp
+ * @brief Source for the time index sidecar of CSV logs
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#include "CSVLogIndex.h"
+#include "CSVCodec.h"
+
+#include <QDateTime>
+#include <QtEndian>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QDebug>
+
+#include <cstring>
+#include <limits>
+
+namespace QMLLogger{
+
+namespace{
+
+const qint64 maxBlockingCountBytes = 1024*1024; ///< Logs with more unindexed bytes than this are counted in the background
+
+/**
+ * @brief Counts the rows of a range of a log on a pool thread
+ */
+class RowCounter : public QRunnable {
+
+public:
+
+    /**
+     * @brief Creates a new counter for the given range of a log
+     *
+     * @param filename Log to count rows in
+     * @param from Beginning of the range, at the beginning of a row
+     * @param to End of the range
+     * @param result Set to the number of rows once counted
+     */
+    RowCounter(QString const& filename, qint64 from, qint64 to, QSharedPointer<QAtomicInteger<qint64>> const& result){
+        this->filename = filename;
+        this->from = from;
+        this->to = to;
+        this->result = result;
+    }
+
+    /**
+     * @brief Counts the rows
+     */
+    void run() override {
+        result->storeRelease(CSVLogIndex::countRows(filename, from, to));
+    }
+
+private:
+
+    QString filename;                                   ///< Log to count rows in
+    qint64 from;                                        ///< Beginning of the range
+    qint64 to;                                          ///< End of the range
+    QSharedPointer<QAtomicInteger<qint64>> result;      ///< Number of rows once counted, -1 until then
+
+};
+
+}
+
+CSVLogIndex::CSVLogIndex(){
+    everyRows = 0;
+    everyMillis = 0;
+    rowCount = 0;
+    lastRow = -1;
+    lastTimestamp = 0;
+    countBase = 0;
+}
+
+CSVLogIndex::~CSVLogIndex(){
+    close();
+}
+
+QString CSVLogIndex::indexFilename(QString const& logFilename){
+    return logFilename + ".idx";
+}
+
+qint64 CSVLogIndex::countRows(QString const& filename, qint64 from, qint64 to){
+    if(to <= from)
+        return 0;
+    QFile log(filename);
+    if(!log.open(QIODevice::ReadOnly))
+        return 0;
+    const uchar* data = log.map(from, to - from);
+    if(!data)
+        return 0;
+    qint64 rows = 0;
+    const char* it = (const char*)data;
+    const char* end = it + (to - from);
+    while((it = CSVCodec::findRowEnd(it, end)) < end){
+        rows++;
+        it++;
+    }
+    return rows;
+}
+
+bool CSVLogIndex::open(QString const& logFilename, qint64 logSize, int everyRows, int everyMillis){
+    close();
+
+    this->everyRows = everyRows;
+    this->everyMillis = everyMillis;
+
+    file.setFileName(indexFilename(logFilename));
+    if(!file.open(QIODevice::ReadWrite)){
+        qCritical() << "CSVLogIndex::open(): Could not open index file: " << file.errorString();
+        return false;
+    }
+
+    //Drop torn entries and entries pointing beyond the end of the log
+    qint64 entries = file.size()/entrySize;
+    uchar entry[entrySize];
+    while(entries > 0){
+        file.seek((entries - 1)*entrySize);
+        if(file.read((char*)entry, entrySize) == entrySize && qFromLittleEndian<qint64>(entry + sizeof(qint64)) < logSize)
+            break;
+        entries--;
+    }
+    if(file.size() != entries*entrySize)
+        file.resize(entries*entrySize);
+
+    //Recover row count from the last entry and count the rest; the header is not a row if there is no entry
+    qint64 countFrom = 0;
+    if(entries > 0){
+        lastTimestamp = qFromLittleEndian<qint64>(entry);
+        lastRow = qFromLittleEndian<qint64>(entry + 2*sizeof(qint64));
+        countFrom = qFromLittleEndian<qint64>(entry + sizeof(qint64));
+        countBase = lastRow;
+    }
+    else{
+        lastTimestamp = 0;
+        lastRow = -1;
+        countBase = -1;
+    }
+
+    //Don't hold up the caller, possibly the GUI thread, with scanning a large log; rows are not indexed until it is counted
+    countedRows.reset();
+    if(logSize - countFrom <= maxBlockingCountBytes)
+        rowCount = qMax((qint64)0, countBase + countRows(logFilename, countFrom, logSize));
+    else{
+        rowCount = 0;
+        countedRows.reset(new QAtomicInteger<qint64>(-1));
+        QThreadPool::globalInstance()->start(new RowCounter(logFilename, countFrom, logSize, countedRows));
+    }
+
+    file.seek(file.size());
+    return true;
+}
+
+void CSVLogIndex::close(){
+    file.close();
+    countedRows.reset();
+}
+
+void CSVLogIndex::addRow(qint64 timestamp, qint64 offset){
+    if(!file.isOpen())
+        return;
+
+    //Rows logged while the log is counted in the background are numbered once the count is in
+    if(countedRows){
+        qint64 counted = countedRows->loadAcquire();
+        if(counted < 0){
+            rowCount++;
+            return;
+        }
+        rowCount += qMax((qint64)0, countBase + counted);
+        countedRows.reset();
+    }
+
+    if(lastRow < 0 ||
+       (everyRows > 0 && rowCount - lastRow >= everyRows) ||
+       (everyMillis > 0 && timestamp - lastTimestamp >= everyMillis)){
+        uchar entry[entrySize];
+        qToLittleEndian<qint64>(timestamp, entry);
+        qToLittleEndian<qint64>(offset, entry + sizeof(qint64));
+        qToLittleEndian<qint64>(rowCount, entry + 2*sizeof(qint64));
+        if(file.write((const char*)entry, entrySize) == entrySize){
+            file.flush();
+            lastRow = rowCount;
+            lastTimestamp = timestamp;
+        }
+        else
+            qCritical() << "CSVLogIndex::addRow(): Could not write to index file: " << file.errorString();
+    }
+    rowCount++;
+}
+
+qint64 CSVLogIndex::extractRange(QString const& logFilename, qint64 from, qint64 to, QIODevice* out){
+    QFile log(logFilename);
+    if(!log.open(QIODevice::ReadOnly)){
+        qCritical() << "CSVLogIndex::extractRange(): Could not open log: " << log.errorString();
+        return -1;
+    }
+    qint64 size = log.size();
+    if(size == 0)
+        return 0;
+    const char* data = (const char*)log.map(0, size);
+    if(!data){
+        qCritical() << "CSVLogIndex::extractRange(): Could not map log: " << log.errorString();
+        return -1;
+    }
+
+    //Header
+    const char* headerEnd = (const char*)memchr(data, '\n', size);
+    if(!headerEnd)
+        return 0;
+    qint64 begin = headerEnd - data + 1;
+    qint64 end = size;
+    out->write(data, begin);
+
+    if(!findRange(logFilename, from, to, &begin, &end))
+        qWarning() << "CSVLogIndex::extractRange(): No usable index found for " + logFilename + ", scanning the whole log.";
+
+    //Without a timestamp column, the index granularity is the best we can do
+    qint64 rows = 0;
+    if(strncmp(data, "timestamp", 9) != 0){
+        out->write(data + begin, end - begin);
+        return countRows(logFilename, begin, end);
+    }
+
+    //Compare timestamps as text in the same format as the first row
+    const char* firstComma = (const char*)memchr(data + begin, ',', end - begin);
+    const char* firstNewline = (const char*)memchr(data + begin, '\n', end - begin);
+    const char* firstFieldEnd = firstComma && (!firstNewline || firstComma < firstNewline) ? firstComma : firstNewline;
+    bool millis = firstFieldEnd && firstFieldEnd - (data + begin) > 19;
+    QByteArray fromKey = timestampKey(from, millis);
+    QByteArray toKey = timestampKey(to, millis);
+
+    //Copy contiguous runs of matching rows straight from the mapped log
+    qint64 runBegin = -1;
+    qint64 lineBegin = begin;
+    while(lineBegin < end){
+        const char* newline = CSVCodec::findRowEnd(data + lineBegin, data + end);
+        qint64 lineEnd = newline < data + end ? newline - data + 1 : end;
+        int keyLength = qMin((qint64)fromKey.size(), lineEnd - lineBegin);
+        bool matches =
+            memcmp(data + lineBegin, fromKey.constData(), keyLength) >= 0 &&
+            memcmp(data + lineBegin, toKey.constData(), keyLength) <= 0;
+        if(matches){
+            rows++;
+            if(runBegin < 0)
+                runBegin = lineBegin;
+        }
+        else if(runBegin >= 0){
+            out->write(data + runBegin, lineBegin - runBegin);
+            runBegin = -1;
+        }
+        lineBegin = lineEnd;
+    }
+    if(runBegin >= 0)
+        out->write(data + runBegin, end - runBegin);
+
+    return rows;
+}
+
+bool CSVLogIndex::findRange(QString const& logFilename, qint64 from, qint64 to, qint64* begin, qint64* end){
+    QFile index(indexFilename(logFilename));
+    if(!index.open(QIODevice::ReadOnly) || index.size() < entrySize)
+        return false;
+    qint64 entries = index.size()/entrySize;
+    const uchar* entryData = index.map(0, entries*entrySize);
+    if(!entryData)
+        return false;
+
+    auto timestampAt = [entryData](qint64 i){ return qFromLittleEndian<qint64>(entryData + i*entrySize); };
+    auto offsetAt = [entryData](qint64 i){ return qFromLittleEndian<qint64>(entryData + i*entrySize + sizeof(qint64)); };
+
+    //The wall clock may have been set back while logging, e.g by NTP, in which case the entries cannot be searched
+    for(qint64 i = 1; i < entries; i++)
+        if(timestampAt(i) < timestampAt(i - 1)){
+            qWarning() << "CSVLogIndex::findRange(): Times in the index of " + logFilename + " go backwards, not using it.";
+            return false;
+        }
+
+    //Timestamps without milliseconds are compared to the second, widen the range to whole seconds
+    if(from > 0)
+        from -= from%1000;
+    if(to > 0 && to < std::numeric_limits<qint64>::max() - 1000)
+        to += 999 - to%1000;
+
+    //Last entry strictly before from, rows of the same millisecond may precede an entry at from
+    qint64 lo = 0, hi = entries;
+    while(lo < hi){
+        qint64 mid = lo + (hi - lo)/2;
+        if(timestampAt(mid) < from)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo > 0)
+        *begin = qMax(*begin, offsetAt(lo - 1));
+
+    //First entry after to
+    hi = entries;
+    while(lo < hi){
+        qint64 mid = lo + (hi - lo)/2;
+        if(timestampAt(mid) <= to)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo < entries)
+        *end = qMin(*end, offsetAt(lo));
+
+    return true;
+}
+
+QByteArray CSVLogIndex::timestampKey(qint64 time, bool millis){
+    return QDateTime::fromMSecsSinceEpoch(time).toString(millis ? "yyyy-MM-dd HH:mm:ss.zzz" : "yyyy-MM-dd HH:mm:ss").toLatin1();
+}
+
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file CSVLogIndex.h
+ * @brief Header for the time index sidecar of CSV logs
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#ifndef CSVLOGINDEX_H
+#define CSVLOGINDEX_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QAtomicInteger>
+
+namespace QMLLogger{
+
+/**
+ * @brief Time index sidecar (`filename.idx`) of a CSV log, for seeking to time ranges without scanning the log.
+ *
+ * The index is a sequence of fixed size entries, each made of three little endian 64-bit integers:
+ *
+ * ```
+ *     timestamp in milliseconds since epoch, byte offset of the row in the log, row number (0 for the first row after the header)
+ * ```
+ *
+ * Entries are only appended after their row is written, so every entry points to a complete row.
+ */
+class CSVLogIndex {
+
+public:
+
+    /**
+     * @brief Creates a new closed index
+     */
+    CSVLogIndex();
+
+    /**
+     * @brief Closes and destroys this index
+     */
+    ~CSVLogIndex();
+
+    /**
+     * @brief Gets the index filename of the given log
+     *
+     * @param logFilename Full path of the log
+     * @return Full path of the index sidecar
+     */
+    static QString indexFilename(QString const& logFilename);
+
+    /**
+     * @brief Opens the index of the given log for appending, dropping entries beyond the end of the log
+     *
+     * The number of rows already in the log is recovered from the last entry, only scanning the log after it. If more
+     * than 1 MiB of the log has to be scanned, it is scanned on a pool thread and no entries are recorded until then.
+     *
+     * @param logFilename Full path of the log
+     * @param logSize Current size of the log in bytes
+     * @param everyRows Record an entry at least every this many rows, 0 to disable
+     * @param everyMillis Record an entry at least every this many milliseconds, 0 to disable
+     * @return Whether the index could be opened
+     */
+    bool open(QString const& logFilename, qint64 logSize, int everyRows, int everyMillis);
+
+    /**
+     * @brief Closes the index
+     */
+    void close();
+
+    /**
+     * @brief Gets whether the index is open
+     *
+     * @return Whether the index is open
+     */
+    bool isOpen() const { return file.isOpen(); }
+
+    /**
+     * @brief Accounts for a new row written to the log, records an entry if due
+     *
+     * @param timestamp Timestamp of the row in milliseconds since epoch
+     * @param offset Byte offset of the row in the log
+     */
+    void addRow(qint64 timestamp, qint64 offset);
+
+    /**
+     * @brief Copies the header and all rows between the given times of a log to the given device
+     *
+     * Uses the index to find the byte range to scan in O(log n), then scans only that range of the memory mapped log,
+     * comparing timestamps as text. If there is no timestamp column, whole index intervals are copied. If there is no
+     * index, or its times go backwards because the wall clock was set back while logging, the whole log is scanned.
+     *
+     * Since timestamps are compared as local time text, rows logged during the hour that is repeated when daylight
+     * saving time ends match by their text, whichever of both hours the given times fall in.
+     *
+     * @param logFilename Full path of the log
+     * @param from Beginning of the time range in milliseconds since epoch, inclusive
+     * @param to End of the time range in milliseconds since epoch, inclusive
+     * @param out Device to write the rows to
+     * @return Number of rows written, 0 for an empty log, -1 on error
+     */
+    static qint64 extractRange(QString const& logFilename, qint64 from, qint64 to, QIODevice* out);
+
+    /**
+     * @brief Narrows down the byte range of a log that may contain rows between the given times using its index
+     *
+     * The index is only used if its times never go backwards; checking this is linear in the number of entries, which
+     * is small compared to the log.
+     *
+     * @param logFilename Full path of the log
+     * @param from Beginning of the time range in milliseconds since epoch, inclusive
+     * @param to End of the time range in milliseconds since epoch, inclusive
+     * @param begin Beginning of the byte range to narrow down, updated in place
+     * @param end End of the byte range to narrow down, updated in place
+     * @return Whether an index was found and used, false if there is none or its times go backwards
+     */
+    static bool findRange(QString const& logFilename, qint64 from, qint64 to, qint64* begin, qint64* end);
+
+    /**
+     * @brief Formats a time in the same way as the timestamps in the log, so that they can be compared as text
+     *
+     * Timestamps are zero-padded and most significant field first, so their text order is their time order.
+     *
+     * @param time Time in milliseconds since epoch
+     * @param millis Whether the log timestamps include milliseconds
+     * @return Formatted time
+     */
+    static QByteArray timestampKey(qint64 time, bool millis);
+
+    /**
+     * @brief Counts the rows ending in the given range of a log, i.e its newlines outside of quoted fields
+     *
+     * @param filename Log to count rows in
+     * @param from Beginning of the range, at the beginning of a row
+     * @param to End of the range
+     * @return Number of rows ending in the range
+     */
+    static qint64 countRows(QString const& filename, qint64 from, qint64 to);
+
+private:
+
+    static const int entrySize = 3*sizeof(qint64); ///< Size of one entry in bytes
+
+    QFile file;             ///< Index file
+    int everyRows;          ///< Entry interval in rows, 0 if disabled
+    int everyMillis;        ///< Entry interval in milliseconds, 0 if disabled
+    qint64 rowCount;        ///< Number of rows in the log
+    qint64 lastRow;         ///< Row number of the last entry, -1 if none
+    qint64 lastTimestamp;   ///< Timestamp of the last entry
+    qint64 countBase;       ///< Row number that the rows counted on open are added to, -1 to not count the header
+    QSharedPointer<QAtomicInteger<qint64>> countedRows; ///< Rows counted in the background, -1 until counted, null if not counting
+
+};
+
+}
+
+#endif /* CSVLOGINDEX_H */
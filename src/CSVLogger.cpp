@@ -26,28 +26,136 @@
 #include "CSVLogger.h"
 
 #include <QDir>
+#include <QStorageInfo>
+#include <QQuickWindow>
+#include <QAbstractEventDispatcher>
+#include <QMutexLocker>
+#include <QElapsedTimer>
 #include <QStandardPaths>
 #include <QDateTime>
 #include <QSysInfo>
 #include <QNetworkInterface>
 #include <QBluetoothLocalDevice>
 
+#include <cstring>
+
 namespace QMLLogger{
 
+namespace{
+
+/**
+ * @brief Lookup table of the CRC-32 (IEEE 802.3, reflected) polynomial
+ */
+struct Crc32Table {
+    quint32 entries[256];   ///< CRC of every byte value
+
+    /**
+     * @brief Computes the table
+     */
+    Crc32Table(){
+        for(quint32 i = 0; i < 256; i++){
+            quint32 c = i;
+            for(int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+/**
+ * @brief Updates a running CRC-32 (IEEE 802.3, reflected) with the given bytes
+ *
+ * @param crc Running CRC state, start with 0xFFFFFFFF and invert at the end
+ * @param data Bytes to add
+ * @param length Number of bytes to add
+ * @return New running CRC state
+ */
+quint32 crc32Update(quint32 crc, const char* data, qint64 length){
+    static const Crc32Table table; //Initialized once even if several writer threads get here at the same time
+    for(qint64 i = 0; i < length; i++)
+        crc = table.entries[(crc ^ (uchar)data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+/**
+ * @brief Appends a plain value to a binary record
+ */
+template<typename T> inline void appendRaw(QByteArray& out, T const& value){
+    out.append((const char*)&value, sizeof(T));
+}
+
+/**
+ * @brief Reads a plain value from a binary record and advances past it
+ */
+template<typename T> inline T readRaw(const char*& it){
+    T value;
+    memcpy(&value, it, sizeof(T));
+    it += sizeof(T);
+    return value;
+}
+
+const int maxInternedLength = 64;       ///< Strings longer than this are rarely repeated and are not interned
+const int maxInternedStrings = 4096;    ///< Strings beyond this many distinct ones are not interned
+const int maxCoalescedBytes = 64*1024;  ///< Coalesced rows are written early if they grow beyond this
+const int recordReserveBytes = 4*1024; ///< Queued records reserve the global memory budget this many bytes at a time
+const int retryMillis = 1000;           ///< Interval at which the storage is retried while rows are kept in memory
+const int maxRecoveryTailBytes = 256*1024; ///< Only this many bytes at the end of an existing log are scanned for a torn row
+const int maxCoalesceMillis = 100;      ///< Coalesced rows are written at most this late if no frame or event loop iteration ends
+
+}
+
+CSVLoggerWriter::CSVLoggerWriter(CSVLogger* logger) : QThread(){
+    this->logger = logger;
+}
+
+void CSVLoggerWriter::run(){
+    logger->runWriter();
+}
+
 CSVLogger::CSVLogger(QQuickItem* parent) :
         QQuickItem(parent),
-        timestampHeader("timestamp")
+        timestampHeader("timestamp"),
+        sessionTimestampHeader("sessionNanos")
 {
     logTime = true;
     logMillis = true;
     toConsole = false;
     precision = 2;
 
+    checksumBlockSize = 0;
+    blockOffset = 0;
+    blockLength = 0;
+    blockCrc = 0xFFFFFFFFu;
+
+    indexRows = 0;
+    indexMillis = 0;
+    writeOffset = 0;
+
+    lineBuffer.reserve(1024);
+
+    memoryBudget = 1024*1024;
+    overflowPolicy = DropNewest;
+    minFreeSpace = 0;
+    diskFull = false;
+    droppedRows = 0;
+    pendingBytes = 0;
+    bytesSinceSpaceCheck = 0;
+
+    coalesce = CoalesceNone;
+    coalesceTimer.setSingleShot(true);
+    coalesceTimer.setInterval(maxCoalesceMillis);
+    connect(&coalesceTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    asynchronous = false;
+    writer = nullptr;
+    droppedRecords = 0;
+    queuedReserved = 0;
+    writerStopping = false;
+    sessionRecords = false;
+    sessionStartMSecs = 0;
+
     fileNeedsReopen = false;
     writing = false;
-
-    LoggerUtil::androidSyncPermission("android.permission.WRITE_EXTERNAL_STORAGE");
-    LoggerUtil::androidSyncPermission("android.permission.READ_EXTERNAL_STORAGE");
 }
 
 CSVLogger::~CSVLogger(){
@@ -55,44 +163,127 @@ CSVLogger::~CSVLogger(){
 }
 
 void CSVLogger::close(){
-    writer.flush();
-    file.close();
+    stopWriter();
+    closeFile();
     fileNeedsReopen = true;
     writing = false;
 }
 
-inline QString CSVLogger::buildLogLine(QVariantList const& data){
-    QString line = "";
+void CSVLogger::closeFile(){
+    flushCoalesced();
+    if(file.isOpen() && !pendingRows.isEmpty() && !flushPending()){
+        qWarning() << "CSVLogger::closeFile(): Storage still cannot be written, dropping rows kept in memory.";
+        if(pendingRows.head().written > 0)
+            truncateTornRow(writeOffset - pendingRows.head().written);
+    }
+    discardPending();
+    setDiskFull(false);
+    finishChecksumBlock();
+    checksumFile.close();
+    index.close();
+    file.close();
+}
 
-    //Timestamp
-    if(logTime){
-        if(logMillis)
-            line += QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz");
-        else
-            line += QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
+inline void CSVLogger::appendNumber(double value, int column, int precision){
+    if(column < columnScale.size())
+        value *= columnScale.at(column);
+    if(column < columnPrecision.size() && columnPrecision.at(column) >= 0)
+        precision = columnPrecision.at(column);
+    CSVCodec::appendDouble(lineBuffer, value, precision);
+}
+
+inline void CSVLogger::appendInteger(qint64 value, int column, int precision){
+    if(column < columnScale.size() && columnScale.at(column) != 1)
+        appendNumber((double)value, column, precision);
+    else
+        CSVCodec::appendInteger(lineBuffer, value);
+}
+
+inline void CSVLogger::appendDatum(QVariant const& datum, int column){
+    switch(datum.userType()){
+        case QMetaType::Double:
+            appendNumber(datum.toDouble(), column, precision);
+            break;
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+            appendInteger(datum.toLongLong(), column, precision);
+            break;
+        case QMetaType::Bool:
+            if(datum.toBool())
+                lineBuffer.append("true", 4);
+            else
+                lineBuffer.append("false", 5);
+            break;
+        case QMetaType::QString: {
+            int from = lineBuffer.size();
+            CSVCodec::appendUtf8(lineBuffer, *static_cast<const QString*>(datum.constData()));
+            CSVCodec::quoteField(lineBuffer, from);
+            break;
+        }
+        default: {
+            int from = lineBuffer.size();
+            CSVCodec::appendUtf8(lineBuffer, datum.toString());
+            CSVCodec::quoteField(lineBuffer, from);
+            break;
+        }
     }
+}
+
+inline qint64 CSVLogger::currentTime(qint64* sessionNanos){
+    if(session){
+        *sessionNanos = session->elapsedNanos();
+        return session->toMSecsSinceEpoch(*sessionNanos);
+    }
+    *sessionNanos = 0;
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+inline void CSVLogger::appendTimestamp(qint64 time, qint64 sessionNanos){
+    if(session)
+        CSVCodec::appendInteger(lineBuffer, sessionNanos);
+    else
+        timestampFormatter.append(lineBuffer, time, logMillis);
+}
+
+inline void CSVLogger::buildLogLine(QVariantList const& data, qint64 time, qint64 sessionNanos){
+    lineBuffer.resize(0);
+
+    //Timestamp
+    if(logTime)
+        appendTimestamp(time, sessionNanos);
 
     //Rest of data
     if(data.size() != header.size())
         qWarning() << "CSVLogger::buildLogLine(): Data and header don't have the same length, log file will not be correct.";
-    if(data.size() > 0){
-        if(logTime)
-            line += ", ";
-        QVariant datum = data.at(0);
-        line += (datum.type() == QVariant::Double ? QString::number(datum.toReal(), 'f', precision) : datum.toString());
-    }
-    for(int i = 1; i < data.size(); i++){
-        QVariant datum = data.at(i);
-        line += ", " + (datum.type() == QVariant::Double ? QString::number(datum.toReal(), 'f', precision) : datum.toString());
+    for(int i = 0; i < data.size(); i++){
+        if(i > 0 || logTime)
+            lineBuffer.append(", ", 2);
+        appendDatum(data.at(i), i);
     }
+}
+
+inline void CSVLogger::buildLogLine(const double* values, int count, qint64 time, qint64 sessionNanos){
+    lineBuffer.resize(0);
+
+    //Timestamp
+    if(logTime)
+        appendTimestamp(time, sessionNanos);
 
-    return line;
+    //Rest of data
+    if(count != header.size())
+        qWarning() << "CSVLogger::buildLogLine(): Data and header don't have the same length, log file will not be correct.";
+    for(int i = 0; i < count; i++){
+        if(i > 0 || logTime)
+            lineBuffer.append(", ", 2);
+        appendNumber(values[i], i, precision);
+    }
 }
 
 inline QString CSVLogger::buildHeaderString(){
     QString headerString = "";
     if(logTime)
-        headerString += timestampHeader;
+        headerString += session ? sessionTimestampHeader : timestampHeader;
     if(header.size() > 0){
         if(logTime)
             headerString += ", ";
@@ -105,8 +296,8 @@ inline QString CSVLogger::buildHeaderString(){
 
 void CSVLogger::setFilename(const QString& filename){
     if(this->filename != filename){
-        writer.flush();
-        file.close();
+        stopWriter();
+        closeFile();
 
         this->filename = filename;
 
@@ -119,7 +310,7 @@ void CSVLogger::setFilename(const QString& filename){
 
 void CSVLogger::setLogTime(bool logTime){
     if(this->logTime != logTime){
-        if(writing)
+        if(writing || writer)
             qCritical() << "CSVLogger::setLogTime(): logTime cannot be changed while writing.";
         else{
             this->logTime = logTime;
@@ -128,9 +319,132 @@ void CSVLogger::setLogTime(bool logTime){
     }
 }
 
+void CSVLogger::setColumnPrecision(QList<int> const& columnPrecision){
+    if(this->columnPrecision != columnPrecision){
+        if(writing || writer)
+            qCritical() << "CSVLogger::setColumnPrecision(): columnPrecision cannot be changed while writing.";
+        else{
+            this->columnPrecision = columnPrecision;
+            emit columnPrecisionChanged();
+        }
+    }
+}
+
+void CSVLogger::setColumnScale(QList<qreal> const& columnScale){
+    if(this->columnScale != columnScale){
+        if(writing || writer)
+            qCritical() << "CSVLogger::setColumnScale(): columnScale cannot be changed while writing.";
+        else{
+            this->columnScale = columnScale;
+            emit columnScaleChanged();
+        }
+    }
+}
+
+void CSVLogger::setCoalesce(CoalesceMode coalesce){
+    if(this->coalesce != coalesce){
+        this->coalesce = coalesce;
+        connectCoalescing();
+        if(coalesce == CoalesceNone)
+            flush();
+        emit coalesceChanged();
+    }
+}
+
+void CSVLogger::itemChange(ItemChange change, ItemChangeData const& value){
+    if(change == ItemSceneChange && coalesce == CoalesceFrame)
+        connectCoalescing(value.window);
+    QQuickItem::itemChange(change, value);
+}
+
+void CSVLogger::connectCoalescing(){
+    connectCoalescing(window());
+}
+
+void CSVLogger::connectCoalescing(QQuickWindow* window){
+    disconnect(coalesceConnection);
+    coalesceConnection = QMetaObject::Connection();
+    if(coalesce == CoalesceFrame && window)
+        coalesceConnection = connect(window, SIGNAL(afterAnimating()), this, SLOT(flush()));
+    else if(coalesce != CoalesceNone && QAbstractEventDispatcher::instance(thread()))
+        coalesceConnection = connect(QAbstractEventDispatcher::instance(thread()), SIGNAL(aboutToBlock()), this, SLOT(flush()));
+}
+
+void CSVLogger::flush(){
+    if(writer)
+        recordsQueued.wakeOne();
+    else
+        flushCoalesced();
+}
+
+void CSVLogger::flushCoalesced(){
+    if(coalescedEnds.isEmpty())
+        return;
+    const char* data = coalescedRows.constData();
+
+    //Go row by row if the storage is in trouble or its free space is due for a check
+    if(diskFull || bytesSinceSpaceCheck >= 1024*1024){
+        int begin = 0;
+        for(int i = 0; i < coalescedEnds.size(); i++){
+            writeRow(QByteArray::fromRawData(data + begin, coalescedEnds[i] - begin), coalescedTimes[i]);
+            begin = coalescedEnds[i];
+        }
+    }
+
+    //Write all rows at once, keeping whatever could not be written in memory
+    else{
+        qint64 batchOffset = writeOffset;
+        qint64 written = writeBytes(data, coalescedRows.size());
+        int begin = 0;
+        for(int i = 0; i < coalescedEnds.size(); i++){
+            int end = coalescedEnds[i];
+            if(begin < written){
+                if(coalescedTimes[i] >= 0)
+                    index.addRow(coalescedTimes[i], batchOffset + begin);
+                if(end > written)
+                    enqueuePending(QByteArray::fromRawData(data + begin, end - begin), -1, int(written - begin));
+            }
+            else
+                enqueuePending(QByteArray::fromRawData(data + begin, end - begin), coalescedTimes[i], 0);
+            begin = end;
+        }
+        if(written < coalescedRows.size()){
+            qWarning() << "CSVLogger::flushCoalesced(): Could not write to file, keeping rows in memory: " << file.errorString();
+            file.unsetError();
+            setDiskFull(true);
+        }
+    }
+
+    coalescedRows.resize(0);
+    coalescedTimes.resize(0);
+    coalescedEnds.resize(0);
+}
+
+void CSVLogger::setAsynchronous(bool asynchronous){
+    if(this->asynchronous != asynchronous){
+        if(writing || writer)
+            qCritical() << "CSVLogger::setAsynchronous(): asynchronous cannot be changed while writing.";
+        else{
+            this->asynchronous = asynchronous;
+            emit asynchronousChanged();
+        }
+    }
+}
+
+void CSVLogger::setSession(LogSession* session){
+    if(this->session != session){
+        if(writing || writer)
+            qCritical() << "CSVLogger::setSession(): session cannot be changed while writing.";
+        else{
+            this->session = session;
+            emit sessionChanged();
+        }
+    }
+}
+
 void CSVLogger::setHeader(QList<QString> const& header){
     if(this->header != header){
-        if(writing)
+        if(writing || writer)
             qCritical() << "CSVLogger::setHeader(): header cannot be changed while writing.";
         else{
             this->header = header;
@@ -139,58 +453,648 @@ void CSVLogger::setHeader(QList<QString> const& header){
     }
 }
 
-void CSVLogger::log(QVariantList const& data){
-    if(!isEnabled())
-        return;
+CSVLogger::RecoverResult CSVLogger::recoverFile(QString const& filename, QByteArray const& headerLine){
+    QFile existing(filename);
+    if(!existing.exists())
+        return Recovered;
+    if(!existing.open(QIODevice::ReadWrite)){
+        qCritical() << "CSVLogger::recoverFile(): Could not open file: " << existing.errorString();
+        return RecoverFailed;
+    }
 
-    if(toConsole){
-        qDebug() << buildLogLine(data);
-        return;
+    //Find the end of the last complete row in the tail only; the tail is taken to begin inside or outside of a quoted
+    //field depending on where its quotes are, so that a row torn inside a quoted field is not mistaken for complete at
+    //one of its line breaks
+    qint64 size = existing.size();
+    qint64 tailOffset = qMax((qint64)0, size - maxRecoveryTailBytes);
+    existing.seek(tailOffset);
+    QByteArray tail = existing.read(size - tailOffset);
+    if(tail.size() != size - tailOffset){
+        qCritical() << "CSVLogger::recoverFile(): Could not read file: " << existing.errorString();
+        return RecoverFailed;
+    }
+    const char* tailEnd = tail.constData() + tail.size();
+    const char* rowEnd = CSVCodec::findLastRowEnd(tail.constData(), tailEnd, tailOffset == 0);
+    qint64 validSize = size;
+    if(rowEnd < tailEnd)
+        validSize = tailOffset + (rowEnd - tail.constData()) + 1;
+    else if(tailOffset == 0)
+        validSize = 0;
+    else
+        qWarning() << "CSVLogger::recoverFile(): No row ends in the last" << tail.size() << "bytes of" << filename << ", leaving it as is";
+
+    //Drop the torn last row, or everything if not even the header was complete
+    if(validSize < size){
+        qWarning() << "CSVLogger::recoverFile(): Truncating" << size - validSize << "bytes of incomplete last row from" << filename;
+        if(!existing.resize(validSize)){
+            qCritical() << "CSVLogger::recoverFile(): Could not truncate file: " << existing.errorString();
+            return RecoverFailed;
+        }
+    }
+
+    //Only the first line needs to be read to check the header
+    bool headerMatches = true;
+    if(validSize > 0){
+        existing.seek(0);
+        headerMatches = existing.readLine(headerLine.size() + 1) == headerLine;
     }
+    existing.close();
+    return headerMatches ? Recovered : HeaderMismatch;
+}
+
+bool CSVLogger::openFile(){
+    QElapsedTimer timer;
+    timer.start();
+    LoggerUtil::requestStoragePermissions();
+
+    QDir dir(filename);
+    if(dir.isAbsolute())
+        qDebug() << "CSVLogger::openFile(): Opening " + filename + " to log.";
+    else{
+        filename =
+            #if defined(Q_OS_WIN)
+                QStandardPaths::writableLocation(QStandardPaths::StandardLocation::AppDataLocation)
+            #else
+                QStandardPaths::writableLocation(QStandardPaths::StandardLocation::DocumentsLocation)
+            #endif
+            + "/" + filename;
+        qDebug() << "CSVLogger::openFile(): Absolute path not given, opening " + filename + " to log.";
+        emit filenameChanged();
+    }
+    QDir::root().mkpath(QFileInfo(filename).absolutePath());
+
+    //Roll over to name-1.ext, name-2.ext, ... if the existing file has another header
+    QString headerString = buildHeaderString();
+    QByteArray headerLine = headerString.toUtf8() + '\n';
+    QFileInfo info(filename);
+    QString candidate = filename;
+    RecoverResult recovered;
+    for(int i = 1; ; i++){
+        recovered = recoverFile(candidate, headerLine);
 
-    //File needs re-opening
-    if(fileNeedsReopen){
-        QDir dir(filename);
-        if(dir.isAbsolute())
-            qDebug() << "CSVLogger::log(): Opening " + filename + " to log.";
+        //Session times restart at 0 with every session, so rows of another session must not be appended to
+        bool otherSession = recovered == Recovered && session &&
+            !session->claimFile(candidate, QFileInfo(candidate).size() <= headerLine.size());
+        if(recovered != HeaderMismatch && !otherSession)
+            break;
+        if(i > 1000){
+            qCritical() << "CSVLogger::openFile(): Could not find a file to roll over to after " + filename;
+            return false;
+        }
+        QString suffix = info.suffix();
+        candidate = info.absolutePath() + "/" + info.completeBaseName() + "-" + QString::number(i) + (suffix.isEmpty() ? "" : "." + suffix);
+    }
+
+    //Not being able to read or repair the file is not a reason to write elsewhere, retry on the next row instead
+    if(recovered == RecoverFailed)
+        return false;
+
+    if(candidate != filename){
+        qWarning() << "CSVLogger::openFile(): Header or session of " + filename + " does not match, rolling over to " + candidate;
+        filename = candidate;
+        emit filenameChanged();
+    }
+
+    file.setFileName(filename);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)){
+        qCritical() << "CSVLogger::openFile(): Could not open file: " << file.errorString();
+        return false;
+    }
+
+    writeOffset = file.size();
+    bytesSinceSpaceCheck = 0;
+    blockOffset = writeOffset;
+    blockLength = 0;
+    blockCrc = 0xFFFFFFFFu;
+    if(checksumBlockSize > 0){
+        checksumFile.setFileName(filename + ".crc");
+        if(!checksumFile.open(QIODevice::WriteOnly | QIODevice::Append))
+            qCritical() << "CSVLogger::openFile(): Could not open checksum file: " << checksumFile.errorString();
+    }
+
+    fileNeedsReopen = false;
+    writing = true;
+
+    if(indexRows > 0 || indexMillis > 0)
+        index.open(filename, writeOffset, indexRows, indexMillis);
+
+    //Keep rows in memory from the start if the storage is already short on space
+    if(!hasFreeSpace()){
+        qWarning() << "CSVLogger::openFile(): Not enough free space for " + filename + ", keeping rows in memory.";
+        setDiskFull(true);
+    }
+
+    //Dump header if file is empty or newly created, ahead of the rows kept in memory while it could not be opened
+    if(file.size() == 0){
+        if(pendingRows.isEmpty())
+            writeRow(headerLine, -1);
         else{
-            filename =
-                #if defined(Q_OS_WIN)
-                    QStandardPaths::writableLocation(QStandardPaths::StandardLocation::AppDataLocation)
-                #else
-                    QStandardPaths::writableLocation(QStandardPaths::StandardLocation::DocumentsLocation)
-                #endif
-                + "/" + filename;
-            qDebug() << "CSVLogger::log(): Absolute path not given, opening " + filename + " to log.";
-            emit filenameChanged();
-        }
-        QDir::root().mkpath(QFileInfo(filename).absolutePath());
-
-        file.setFileName(filename);
-        if(!file.open(QIODevice::WriteOnly | QIODevice::Append)){
-            qCritical() << "CSVLogger::log(): Could not open file: " << file.errorString();
+            PendingRow pending;
+            pending.bytes = headerLine;
+            pending.time = -1;
+            pending.written = 0;
+            pendingRows.prepend(pending);
+            pendingBytes += headerLine.size();
+            LoggerUtil::reservePendingBytes(headerLine.size(), true);
+            notifyChanged("pendingBytesChanged");
+        }
+    }
+
+    qCDebug(loggerStartup) << "CSVLogger::openFile(): Opened " + filename + " in" << timer.nsecsElapsed()/1000 << "us";
+    return true;
+}
+
+qint64 CSVLogger::writeBytes(const char* data, qint64 size){
+    qint64 written = file.write(data, size);
+    if(written <= 0)
+        return 0;
+    writeOffset += written;
+    bytesSinceSpaceCheck += written;
+
+    if(checksumFile.isOpen()){
+        blockCrc = crc32Update(blockCrc, data, written);
+        blockLength += written;
+        if(blockLength >= checksumBlockSize && data[written - 1] == '\n')
+            finishChecksumBlock();
+    }
+    return written;
+}
+
+void CSVLogger::writeRow(QByteArray const& row, qint64 time){
+    if(diskFull){
+        enqueuePending(row, time, 0);
+        return;
+    }
+
+    //Statting the storage is too slow to do on every row
+    if(bytesSinceSpaceCheck >= 1024*1024){
+        bytesSinceSpaceCheck = 0;
+        if(!hasFreeSpace()){
+            qWarning() << "CSVLogger::writeRow(): Less than " << minFreeSpace << " bytes free, keeping rows in memory.";
+            setDiskFull(true);
+            enqueuePending(row, time, 0);
             return;
         }
-        else
-            writer.setDevice(&file);
+    }
+
+    qint64 rowOffset = writeOffset;
+    qint64 written = writeBytes(row.constData(), row.size());
+    if(written > 0 && time >= 0)
+        index.addRow(time, rowOffset);
+    if(written < row.size()){
+        qWarning() << "CSVLogger::writeRow(): Could not write to file, keeping rows in memory: " << file.errorString();
+        file.unsetError();
+        enqueuePending(row, written > 0 ? -1 : time, (int)written);
+        setDiskFull(true);
+    }
+}
+
+void CSVLogger::enqueuePending(QByteArray const& row, qint64 time, int written){
+    qint64 size = row.size();
+    qint64 droppedBefore = droppedRows;
+
+    //A partially written row must be completed or the file would be left with a torn line
+    if(written > 0)
+        LoggerUtil::reservePendingBytes(size, true);
+    else
+        while(pendingBytes + size > memoryBudget || !LoggerUtil::reservePendingBytes(size)){
+            if(overflowPolicy == DropOldest && !pendingRows.isEmpty() && pendingRows.head().written == 0){
+                qint64 oldest = pendingRows.dequeue().bytes.size();
+                pendingBytes -= oldest;
+                LoggerUtil::releasePendingBytes(oldest);
+                droppedRows++;
+            }
+            else{
+                droppedRows++;
+                notifyChanged("droppedRowsChanged");
+                if(droppedRows - droppedBefore > 1)
+                    notifyChanged("pendingBytesChanged");
+                return;
+            }
+        }
 
-        fileNeedsReopen = false;
-        writing = true;
+    //Deep copy so that the line buffer keeps its capacity
+    PendingRow pending;
+    pending.bytes = QByteArray(row.constData(), row.size());
+    pending.time = time;
+    pending.written = written;
+    pendingRows.enqueue(pending);
+    pendingBytes += size;
+    if(droppedRows != droppedBefore)
+        notifyChanged("droppedRowsChanged");
+    notifyChanged("pendingBytesChanged");
+}
 
-        //Build and dump header if file is empty or newly created
-        if(file.pos() == 0){
-            writer << buildHeaderString() << "\n";
-            writer.flush();
+bool CSVLogger::flushPending(){
+    bool flushed = true;
+    qint64 pendingBefore = pendingBytes;
+    while(!pendingRows.isEmpty()){
+        PendingRow& row = pendingRows.head();
+        qint64 rowOffset = writeOffset;
+        qint64 written = writeBytes(row.bytes.constData() + row.written, row.bytes.size() - row.written);
+        if(written > 0 && row.written == 0 && row.time >= 0)
+            index.addRow(row.time, rowOffset);
+        row.written += (int)written;
+        if(row.written < row.bytes.size()){
+            file.unsetError();
+            flushed = false;
+            break;
         }
+        pendingBytes -= row.bytes.size();
+        LoggerUtil::releasePendingBytes(row.bytes.size());
+        pendingRows.dequeue();
     }
+    if(pendingBytes != pendingBefore)
+        notifyChanged("pendingBytesChanged");
+    return flushed;
+}
+
+void CSVLogger::discardPending(){
+    if(pendingRows.isEmpty())
+        return;
+    droppedRows += pendingRows.size();
+    LoggerUtil::releasePendingBytes(pendingBytes);
+    pendingRows.clear();
+    pendingBytes = 0;
+    notifyChanged("droppedRowsChanged");
+    notifyChanged("pendingBytesChanged");
+}
+
+bool CSVLogger::hasFreeSpace(){
+    QStorageInfo storage(QFileInfo(file.fileName()).absolutePath());
+    return !storage.isValid() || storage.bytesAvailable() > minFreeSpace;
+}
 
-    //Actual data logging
+void CSVLogger::setDiskFull(bool diskFull){
+    if(this->diskFull != diskFull){
+        this->diskFull = diskFull;
+        if(diskFull)
+            retryClock.start();
+        notifyChanged("diskFullChanged");
+    }
+}
+
+void CSVLogger::notifyChanged(const char* signal){
+    //Property bindings must be notified on the thread they live in, not on the writer thread
+    if(QThread::currentThread() == thread())
+        QMetaObject::invokeMethod(this, signal, Qt::DirectConnection);
+    else
+        QMetaObject::invokeMethod(this, signal, Qt::QueuedConnection);
+}
+
+void CSVLogger::truncateTornRow(qint64 rowOffset){
+    if(!file.resize(rowOffset)){
+        qCritical() << "CSVLogger::truncateTornRow(): Could not truncate incomplete last row: " << file.errorString();
+        return;
+    }
+    writeOffset = rowOffset;
+
+    //Checksum blocks end at row boundaries, so only the current block covers the truncated bytes
+    if(checksumFile.isOpen() && rowOffset >= blockOffset){
+        QFile written(file.fileName());
+        QByteArray block;
+        if(written.open(QIODevice::ReadOnly) && written.seek(blockOffset))
+            block = written.read(rowOffset - blockOffset);
+        blockLength = block.size();
+        blockCrc = crc32Update(0xFFFFFFFFu, block.constData(), block.size());
+    }
+}
+
+void CSVLogger::retryPending(){
+    if(writer && QThread::currentThread() != writer)
+        return;
+    retryClock.start();
+    if(!file.isOpen()){
+        if(!fileNeedsReopen){
+            setDiskFull(false);
+            return;
+        }
+        if(!openFile())
+            return;
+    }
+    if(hasFreeSpace() && flushPending()){
+        qDebug() << "CSVLogger::retryPending(): Storage accepts rows again, resuming.";
+        bytesSinceSpaceCheck = 0;
+        setDiskFull(false);
+    }
+}
+
+void CSVLogger::finishChecksumBlock(){
+    if(!checksumFile.isOpen() || blockLength == 0)
+        return;
+    QByteArray entry = QByteArray::number(blockOffset) + ", " + QByteArray::number(blockLength) + ", " +
+        QByteArray::number(blockCrc ^ 0xFFFFFFFFu, 16).rightJustified(8, '0') + "\n";
+    checksumFile.write(entry);
+    checksumFile.flush();
+    blockOffset += blockLength;
+    blockLength = 0;
+    blockCrc = 0xFFFFFFFFu;
+}
+
+void CSVLogger::commitLine(qint64 time){
+    if(toConsole){
+        qDebug() << QString::fromUtf8(lineBuffer);
+        return;
+    }
+
+    //The storage is retried by the thread that logs, the only one that touches the file and the rows kept in memory;
+    //the writer thread retries on its own
+    if(diskFull && !writer && retryClock.hasExpired(retryMillis))
+        retryPending();
+
+    //File needs re-opening; until it can be, e.g while storage access is being granted, rows are kept in memory and
+    //the retries reopen it
+    if(fileNeedsReopen && (diskFull || !openFile())){
+        lineBuffer.append('\n');
+        enqueuePending(lineBuffer, time, 0);
+        setDiskFull(true);
+        return;
+    }
+
+    //Actual data logging, batched until the end of the frame or event loop iteration if coalescing
     if(file.isOpen()){
-        writer << buildLogLine(data) << "\n";
-        writer.flush();
+        lineBuffer.append('\n');
+        if(writer || coalesce != CoalesceNone){
+            if(coalescedEnds.isEmpty()){
+                coalescedRows.reserve(2*maxCoalescedBytes);
+                coalescedTimes.reserve(1024);
+                coalescedEnds.reserve(1024);
+
+                //Deadline in case no frame or event loop iteration ends, e.g because the window is hidden
+                if(!writer)
+                    QMetaObject::invokeMethod(&coalesceTimer, "start");
+            }
+            coalescedRows.append(lineBuffer);
+            coalescedTimes.append(time);
+            coalescedEnds.append(coalescedRows.size());
+            if(coalescedRows.size() >= maxCoalescedBytes)
+                flushCoalesced();
+        }
+        else
+            writeRow(lineBuffer, time);
     }
     else
         qCritical() << "CSVLogger::log(): File is not open, valid filename must be provided beforehand.";
 }
 
+bool CSVLogger::startWriter(){
+    if(writer)
+        return true;
+    if(!toConsole && fileNeedsReopen && (diskFull || !openFile()))
+        return false;
+
+    sessionRecords = !session.isNull();
+    sessionStartMSecs = session ? session->toMSecsSinceEpoch(0) : 0;
+    queuedRecords.reserve(64*1024);
+    writtenRecords.reserve(64*1024);
+    writerStopping = false;
+    writer = new CSVLoggerWriter(this);
+    writer->start();
+    return true;
+}
+
+void CSVLogger::stopWriter(){
+    if(!writer)
+        return;
+    {
+        QMutexLocker locker(&recordMutex);
+        writerStopping = true;
+    }
+    recordsQueued.wakeOne();
+    writer->wait();
+    delete writer;
+    writer = nullptr;
+    LoggerUtil::releasePendingBytes(queuedReserved);
+    queuedReserved = 0;
+
+    internedIds.clear();
+    internedFields.clear();
+}
+
+void CSVLogger::runWriter(){
+    QMutexLocker locker(&recordMutex);
+    while(true){
+        if(queuedRecords.isEmpty() && droppedRecords == 0){
+            if(writerStopping)
+                break;
+            if(diskFull)
+                recordsQueued.wait(&recordMutex, retryMillis);
+            else
+                recordsQueued.wait(&recordMutex);
+        }
+        queuedRecords.swap(writtenRecords);
+        qint64 dropped = droppedRecords;
+        droppedRecords = 0;
+        qint64 reserved = queuedReserved;
+        queuedReserved = 0;
+        locker.unlock();
+
+        if(dropped > 0){
+            droppedRows += dropped;
+            notifyChanged("droppedRowsChanged");
+        }
+        writeRecords(writtenRecords);
+        writtenRecords.resize(0);
+        LoggerUtil::releasePendingBytes(reserved);
+        flushCoalesced();
+        if(diskFull)
+            retryPending();
+
+        locker.relock();
+    }
+}
+
+bool CSVLogger::beginRecord(int count, quint8 flags){
+    if(queuedRecords.size() >= memoryBudget){
+        droppedRecords++;
+        return false;
+    }
+
+    //Queued records count toward the budget of all loggers together too, reserved a few KiB at a time
+    while(queuedRecords.size() >= queuedReserved){
+        if(!LoggerUtil::reservePendingBytes(recordReserveBytes)){
+            droppedRecords++;
+            return false;
+        }
+        queuedReserved += recordReserveBytes;
+    }
+    RecordHeader header;
+    header.time = session ? session->elapsedNanos() : QDateTime::currentMSecsSinceEpoch();
+    header.count = count;
+    header.precision = (quint8)qBound(0, precision, 30);
+    header.flags = flags | (logMillis ? MillisRecord : 0);
+    appendRaw(queuedRecords, header);
+    return true;
+}
+
+void CSVLogger::recordQueued(int queuedBefore, int queuedAfter){
+    //When coalescing, the writer thread is woken up at the end of the frame or event loop iteration, or early if the
+    //records pile up, so that they are not dropped for lack of memory while waiting
+    int wakeBytes = qMin(maxCoalescedBytes, memoryBudget/2);
+    if(coalesce == CoalesceNone ? queuedBefore == 0 : queuedBefore < wakeBytes && queuedAfter >= wakeBytes)
+        recordsQueued.wakeOne();
+
+    //Deadline in case no frame or event loop iteration ends, e.g because the window is hidden; log() may be called
+    //from another thread than the timer's
+    if(coalesce != CoalesceNone && queuedBefore == 0)
+        QMetaObject::invokeMethod(&coalesceTimer, "start");
+}
+
+void CSVLogger::appendRecordString(QString const& string){
+    if(string.size() <= maxInternedLength){
+        QHash<QString, quint32>::const_iterator interned = internedIds.constFind(string);
+        if(interned != internedIds.constEnd()){
+            queuedRecords.append((char)StringTag);
+            appendRaw(queuedRecords, interned.value());
+            return;
+        }
+        if(internedIds.size() < maxInternedStrings){
+            quint32 id = internedIds.size();
+            internedIds.insert(string, id);
+            queuedRecords.append((char)NewStringTag);
+            appendRaw(queuedRecords, id);
+        }
+    }
+    queuedRecords.append((char)InlineStringTag);
+    appendRaw(queuedRecords, (qint32)string.size());
+    if(queuedRecords.size() & 1)
+        queuedRecords.append('\0');
+    queuedRecords.append((const char*)string.utf16(), string.size()*(int)sizeof(ushort));
+}
+
+void CSVLogger::writeRecords(QByteArray const& records){
+    const char* it = records.constData();
+    const char* end = it + records.size();
+    while(it < end){
+        RecordHeader header = readRaw<RecordHeader>(it);
+        qint64 time = sessionRecords ? sessionStartMSecs + header.time/1000000 : header.time;
+
+        lineBuffer.resize(0);
+        if(logTime){
+            if(sessionRecords)
+                CSVCodec::appendInteger(lineBuffer, header.time);
+            else
+                timestampFormatter.append(lineBuffer, time, header.flags & MillisRecord);
+        }
+        for(int i = 0; i < header.count; i++){
+            if(i > 0 || logTime)
+                lineBuffer.append(", ", 2);
+            if(header.flags & DoublesRecord){
+                appendNumber(readRaw<double>(it), i, header.precision);
+                continue;
+            }
+            char tag = *it++;
+            switch(tag){
+                case DoubleTag:
+                    appendNumber(readRaw<double>(it), i, header.precision);
+                    break;
+                case IntegerTag:
+                    appendInteger(readRaw<qint64>(it), i, header.precision);
+                    break;
+                case TrueTag:
+                    lineBuffer.append("true", 4);
+                    break;
+                case FalseTag:
+                    lineBuffer.append("false", 5);
+                    break;
+                case StringTag:
+                    lineBuffer.append(internedFields.at(readRaw<quint32>(it)));
+                    break;
+                case NewStringTag:
+                case InlineStringTag: {
+                    //Ids are assigned in order, skip the id and the inline string tag that follows
+                    if(tag == NewStringTag)
+                        it += sizeof(quint32) + 1;
+                    qint32 length = readRaw<qint32>(it);
+                    if((it - records.constData()) & 1)
+                        it++;
+                    int from = lineBuffer.size();
+                    CSVCodec::appendUtf8(lineBuffer, (const ushort*)it, length);
+                    CSVCodec::quoteField(lineBuffer, from);
+                    it += length*sizeof(ushort);
+                    if(tag == NewStringTag)
+                        internedFields.append(lineBuffer.mid(from));
+                    break;
+                }
+            }
+        }
+        commitLine(time);
+    }
+}
+
+void CSVLogger::log(QVariantList const& data){
+    if(!isEnabled())
+        return;
+    if(coalesce != CoalesceNone && !coalesceConnection)
+        connectCoalescing();
+
+    //Until the file can be opened and the writer thread started, rows are kept in memory on this thread instead
+    if(asynchronous && startWriter()){
+        if(data.size() != header.size())
+            qWarning() << "CSVLogger::log(): Data and header don't have the same length, log file will not be correct.";
+        QMutexLocker locker(&recordMutex);
+        int queuedBefore = queuedRecords.size();
+        if(!beginRecord(data.size(), 0))
+            return;
+        for(QVariant const& datum : data)
+            switch(datum.userType()){
+                case QMetaType::Double:
+                    queuedRecords.append((char)DoubleTag);
+                    appendRaw(queuedRecords, datum.toDouble());
+                    break;
+                case QMetaType::Int:
+                case QMetaType::UInt:
+                case QMetaType::LongLong:
+                    queuedRecords.append((char)IntegerTag);
+                    appendRaw(queuedRecords, datum.toLongLong());
+                    break;
+                case QMetaType::Bool:
+                    queuedRecords.append((char)(datum.toBool() ? TrueTag : FalseTag));
+                    break;
+                case QMetaType::QString:
+                    appendRecordString(*static_cast<const QString*>(datum.constData()));
+                    break;
+                default:
+                    appendRecordString(datum.toString());
+                    break;
+            }
+        int queuedAfter = queuedRecords.size();
+        locker.unlock();
+        recordQueued(queuedBefore, queuedAfter);
+        return;
+    }
+
+    qint64 sessionNanos;
+    qint64 now = currentTime(&sessionNanos);
+    buildLogLine(data, now, sessionNanos);
+    commitLine(now);
+}
+
+void CSVLogger::log(const double* values, int count){
+    if(!isEnabled())
+        return;
+    if(coalesce != CoalesceNone && !coalesceConnection)
+        connectCoalescing();
+
+    //Until the file can be opened and the writer thread started, rows are kept in memory on this thread instead
+    if(asynchronous && startWriter()){
+        if(count != header.size())
+            qWarning() << "CSVLogger::log(): Data and header don't have the same length, log file will not be correct.";
+        QMutexLocker locker(&recordMutex);
+        int queuedBefore = queuedRecords.size();
+        if(!beginRecord(count, DoublesRecord))
+            return;
+        queuedRecords.append((const char*)values, count*(int)sizeof(double));
+        int queuedAfter = queuedRecords.size();
+        locker.unlock();
+        recordQueued(queuedBefore, queuedAfter);
+        return;
+    }
+
+    qint64 sessionNanos;
+    qint64 now = currentTime(&sessionNanos);
+    buildLogLine(values, count, now, sessionNanos);
+    commitLine(now);
+}
+
 }
@@ -29,9 +29,57 @@
 #include <QString>
 #include <QFile>
 #include <QVariant>
+#include <QByteArray>
+#include <QPointer>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QVector>
+#include <QAtomicInteger>
+
+#include "CSVLogIndex.h"
+#include "CSVCodec.h"
+#include "LogSession.h"
 
 namespace QMLLogger{
 
+class CSVLogger;
+
+/** @cond DO_NOT_DOCUMENT */
+
+/**
+ * @brief Thread that formats and writes the records of an asynchronous CSVLogger
+ */
+class CSVLoggerWriter : public QThread {
+
+public:
+
+    /**
+     * @brief Creates a new writer thread for the given logger
+     *
+     * @param logger Logger whose records to write
+     */
+    CSVLoggerWriter(CSVLogger* logger);
+
+protected:
+
+    /**
+     * @brief Formats and writes records until the logger stops the thread
+     */
+    void run() override;
+
+private:
+
+    CSVLogger* logger;              ///< Logger whose records to write
+
+};
+
+/** @endcond */
+
 /**
  * @brief Utility to log CSV data line by line with optional timestamp.
  *
@@ -56,6 +104,57 @@ namespace QMLLogger{
  * ```
  *     timestamp in yyyy-MM-dd HH:mm:ss.zzz format if enabled, data[0], data[1], ..., data[N - 1]
  * ```
+ *
+ * When an existing log file is opened, only its first line and its last 256 KiB are read. A partial last row left
+ * behind by an interrupted write, even one torn inside a quoted field, is truncated away. If the first line does not
+ * match the current header (including the timestamp field), the log rolls over to the first of `name-1.ext`,
+ * `name-2.ext`, ... that is empty or has a matching header, and `filename` is updated accordingly. If the existing file
+ * cannot be read or truncated, e.g because it is read-only or storage access is not granted yet, the log does not roll
+ * over; opening is retried with the next row.
+ *
+ * If `checksumBlockSize` is positive, the CRC-32 of every block of approximately that many bytes (always ending at a
+ * line boundary) is appended to `filename.crc` as `offset, length, crc` lines, offset and length in decimal bytes and
+ * crc in hexadecimal. Offline tools can validate a log block by block against it without parsing it.
+ *
+ * If `indexRows` or `indexMillis` is positive, a time index is maintained in `filename.idx` (see CSVLogIndex) that
+ * allows extracting time ranges from very large logs without scanning them, e.g. with the `log-extract` tool.
+ *
+ * If `session` is set, the timestamp field is replaced by a `sessionNanos` field containing the nanoseconds elapsed
+ * since the LogSession started, which is monotonic and shared by all loggers of the session (see LogSession). Since it
+ * restarts at 0 with every session, such a log is only appended to by the session that started it; a log that already
+ * has rows of another session, e.g of a previous run of the app, rolls over like one with another header.
+ *
+ * If a row cannot be written because the storage is full or failing, or because less than `minFreeSpace` bytes would
+ * remain free on it, `diskFull` becomes `true` and rows are kept in memory, up to `memoryBudget` bytes for this
+ * logger and `LoggerUtil.memoryBudget` bytes for all loggers together. Rows that do not fit are dropped according to
+ * `overflowPolicy` and counted in `droppedRows`. The storage is retried at most once a second, with the next row
+ * logged, and the rows kept in memory are written in order as soon as it accepts them again, after which `diskFull`
+ * goes back to `false`. Rows that are
+ * still in memory when the log is closed are counted as dropped; the beginning of a row that the storage only took
+ * part of is truncated away, so the log never ends with a torn line. Rows logged while the file cannot be opened, e.g
+ * while storage access is being granted on first run, are kept in memory in the same way until the retries open it;
+ * the header is written ahead of them.
+ *
+ * String fields that contain a comma, a quote or a line break are quoted as per RFC 4180, i.e enclosed in quotes with
+ * their quotes doubled; the readers and tools of this plugin understand such fields. Other fields are copied as is.
+ *
+ * Lines are formatted into a buffer owned by the logger that is reused from row to row, so logging does not allocate
+ * once the buffer has grown to the longest line, as long as the data consists of numbers, booleans and strings. C++
+ * callers can avoid building a QVariantList altogether with `log(const double*, int)`.
+ *
+ * If `asynchronous` is `true`, `log()` only copies the raw values and the raw clock reading into a compact binary
+ * record and returns; formatting (including `precision`) and writing happen on a writer thread owned by the logger.
+ * Short strings are interned so that repeated ones are only copied once. Queued records count toward `memoryBudget`
+ * and `LoggerUtil.memoryBudget`; records that do not fit are dropped and counted in `droppedRows`. `close()` and
+ * changing `filename` wait for all queued records to be written.
+ *
+ * If `coalesce` is `CSVLogger.CoalesceFrame` or `CSVLogger.CoalesceEventLoop`, rows are collected and written with a
+ * single write after the logger's window animates for the next frame, or when the event loop is about to wait,
+ * respectively, instead of one write per `log()`. Rows are also written at most 100 ms after the first one of a batch
+ * in case no frame comes, e.g because the window is hidden or the application is in the background. The writer thread
+ * of an asynchronous logger always writes the rows it formats in one go, and is only woken up at these points when
+ * coalescing, or as soon as 64 KiB or half of `memoryBudget` of records are queued, so that records are not dropped
+ * while waiting.
  */
 class CSVLogger : public QQuickItem {
     /* *INDENT-OFF* */
@@ -77,11 +176,72 @@ class CSVLogger : public QQuickItem {
     /** @brief Number of decimal places for printing floating point numbers, default `2`*/
     Q_PROPERTY(int precision MEMBER precision)
 
+    /** @brief Number of decimal places per column (excluding timestamp), negative or missing entries use `precision`, cannot be changed after a call to `log()` until a call to `close()`, default `[]` */
+    Q_PROPERTY(QList<int> columnPrecision WRITE setColumnPrecision READ getColumnPrecision NOTIFY columnPrecisionChanged)
+
+    /** @brief Factor per column (excluding timestamp) that numbers are multiplied with before printing, e.g `100` for percentages, missing entries are `1`, cannot be changed after a call to `log()` until a call to `close()`, default `[]` */
+    Q_PROPERTY(QList<qreal> columnScale WRITE setColumnScale READ getColumnScale NOTIFY columnScaleChanged)
+
     /** @brief Header fields (excluding timestamp), cannot be changed after a call to `log()` until a call to `close()`, default `[]` */
     Q_PROPERTY(QList<QString> header WRITE setHeader READ getHeader NOTIFY headerChanged)
 
+    /** @brief Session whose monotonic clock stamps the rows instead of the wall clock, cannot be changed after a call to `log()` until a call to `close()`, default `null` */
+    Q_PROPERTY(QMLLogger::LogSession* session WRITE setSession READ getSession NOTIFY sessionChanged)
+
+    /** @brief Approximate size in bytes of checksummed blocks written to `filename.crc`, `0` to disable, default `0` */
+    Q_PROPERTY(int checksumBlockSize MEMBER checksumBlockSize)
+
+    /** @brief Record a time index entry to `filename.idx` at least every this many rows, `0` to disable, default `0` */
+    Q_PROPERTY(int indexRows MEMBER indexRows)
+
+    /** @brief Record a time index entry to `filename.idx` at least every this many milliseconds, `0` to disable, default `0` */
+    Q_PROPERTY(int indexMillis MEMBER indexMillis)
+
+    /** @brief Maximum number of bytes of rows this logger keeps in memory while the storage cannot be written, default 1 MiB */
+    Q_PROPERTY(int memoryBudget MEMBER memoryBudget)
+
+    /** @brief Which rows to drop when the memory budget is exhausted, default `CSVLogger.DropNewest` */
+    Q_PROPERTY(OverflowPolicy overflowPolicy MEMBER overflowPolicy)
+
+    /** @brief Number of bytes that must remain free on the storage, checked on open and about every MiB written, default `0` */
+    Q_PROPERTY(qint64 minFreeSpace MEMBER minFreeSpace)
+
+    /** @brief Whether rows are being kept in memory because the storage is full or cannot be written */
+    Q_PROPERTY(bool diskFull READ getDiskFull NOTIFY diskFullChanged)
+
+    /** @brief Number of rows dropped so far because they did not fit in the memory budget */
+    Q_PROPERTY(qint64 droppedRows READ getDroppedRows NOTIFY droppedRowsChanged)
+
+    /** @brief Number of bytes of rows currently kept in memory */
+    Q_PROPERTY(qint64 pendingBytes READ getPendingBytes NOTIFY pendingBytesChanged)
+
+    /** @brief When to write rows, default `CSVLogger.CoalesceNone` */
+    Q_PROPERTY(CoalesceMode coalesce WRITE setCoalesce READ getCoalesce NOTIFY coalesceChanged)
+
+    /** @brief Whether to format and write rows on a writer thread, cannot be changed after a call to `log()` until a call to `close()`, default `false` */
+    Q_PROPERTY(bool asynchronous WRITE setAsynchronous READ getAsynchronous NOTIFY asynchronousChanged)
+
 public:
 
+    /**
+     * @brief Rows to drop when the memory budget is exhausted
+     */
+    enum OverflowPolicy {
+        DropNewest = 0, ///< Drop the rows being logged, keeping the contiguous beginning of the outage
+        DropOldest      ///< Drop the oldest rows kept in memory, keeping the most recent ones
+    };
+    Q_ENUM(OverflowPolicy)
+
+    /**
+     * @brief When to write rows
+     */
+    enum CoalesceMode {
+        CoalesceNone = 0,          ///< Write every row as soon as it is logged
+        CoalesceEventLoop,         ///< Write the rows logged during an event loop iteration at once, before the event loop waits
+        CoalesceFrame              ///< Write the rows logged during a frame at once, after the window animates; like CoalesceEventLoop if not in a window
+    };
+    Q_ENUM(CoalesceMode)
+
     /** @cond DO_NOT_DOCUMENT */
 
     /**
@@ -138,8 +298,107 @@ public:
      */
     QList<QString> getHeader(){ return header; }
 
+    /**
+     * @brief Sets the number of decimal places per column, has no effect after the first log()
+     *
+     * @param columnPrecision Number of decimal places per column, negative to use precision
+     */
+    void setColumnPrecision(QList<int> const& columnPrecision);
+
+    /**
+     * @brief Gets the number of decimal places per column
+     *
+     * @return Number of decimal places per column
+     */
+    QList<int> getColumnPrecision(){ return columnPrecision; }
+
+    /**
+     * @brief Sets the factor per column that numbers are multiplied with, has no effect after the first log()
+     *
+     * @param columnScale Factor per column
+     */
+    void setColumnScale(QList<qreal> const& columnScale);
+
+    /**
+     * @brief Gets the factor per column that numbers are multiplied with
+     *
+     * @return Factor per column
+     */
+    QList<qreal> getColumnScale(){ return columnScale; }
+
+    /**
+     * @brief Sets the session whose clock stamps the rows, has no effect after the first log()
+     *
+     * @param session New session, null to use the wall clock
+     */
+    void setSession(LogSession* session);
+
+    /**
+     * @brief Gets the session whose clock stamps the rows
+     *
+     * @return The session, null if the wall clock is used
+     */
+    LogSession* getSession(){ return session; }
+
+    /**
+     * @brief Sets when to write rows
+     *
+     * @param coalesce When to write rows
+     */
+    void setCoalesce(CoalesceMode coalesce);
+
+    /**
+     * @brief Gets when rows are written
+     *
+     * @return When rows are written
+     */
+    CoalesceMode getCoalesce(){ return coalesce; }
+
+    /**
+     * @brief Sets whether to format and write rows on a writer thread, has no effect after the first log()
+     *
+     * @param asynchronous Whether to write asynchronously
+     */
+    void setAsynchronous(bool asynchronous);
+
+    /**
+     * @brief Gets whether rows are formatted and written on a writer thread
+     *
+     * @return Whether writing is asynchronous
+     */
+    bool getAsynchronous(){ return asynchronous; }
+
+    /**
+     * @brief Gets whether rows are being kept in memory because the storage cannot be written
+     *
+     * @return Whether the storage is full or failing
+     */
+    bool getDiskFull(){ return diskFull.load() != 0; }
+
+    /**
+     * @brief Gets the number of rows dropped so far
+     *
+     * @return Number of dropped rows
+     */
+    qint64 getDroppedRows(){ return droppedRows.load(); }
+
+    /**
+     * @brief Gets the number of bytes of rows kept in memory
+     *
+     * @return Number of pending bytes
+     */
+    qint64 getPendingBytes(){ return pendingBytes.load(); }
+
     /** @endcond */
 
+    /**
+     * @brief Logs the given numbers as one entry, without going through QVariant
+     *
+     * @param values Numbers to log, must conform to the header format if meaningful log is desired
+     * @param count Number of values
+     */
+    void log(const double* values, int count);
+
 signals:
 
     /** @cond DO_NOT_DOCUMENT */
@@ -159,6 +418,46 @@ signals:
      */
     void headerChanged();
 
+    /**
+     * @brief Emitted when the session changes
+     */
+    void sessionChanged();
+
+    /**
+     * @brief Emitted when columnPrecision changes
+     */
+    void columnPrecisionChanged();
+
+    /**
+     * @brief Emitted when columnScale changes
+     */
+    void columnScaleChanged();
+
+    /**
+     * @brief Emitted when coalesce changes
+     */
+    void coalesceChanged();
+
+    /**
+     * @brief Emitted when asynchronous changes
+     */
+    void asynchronousChanged();
+
+    /**
+     * @brief Emitted when diskFull changes
+     */
+    void diskFullChanged();
+
+    /**
+     * @brief Emitted when rows are dropped
+     */
+    void droppedRowsChanged();
+
+    /**
+     * @brief Emitted when the number of bytes kept in memory changes
+     */
+    void pendingBytesChanged();
+
     /** @endcond */
 
 public slots:
@@ -170,13 +469,86 @@ public slots:
      */
     void log(QVariantList const& data);
 
+    /**
+     * @brief Writes the coalesced rows now instead of waiting for the end of the frame or event loop iteration
+     *
+     * Wakes the writer thread up to write them when asynchronous. Must be called from the logger's thread, or from the
+     * thread that logs when the logger is only used from that thread.
+     */
+    void flush();
+
     /**
      * @brief Closes the log file
      */
     void close();
 
+protected:
+
+    /** @cond DO_NOT_DOCUMENT */
+
+    /**
+     * @brief Follows the window the logger is in to write coalesced rows after it animates
+     *
+     * @param change Kind of change
+     * @param value Changed data
+     */
+    void itemChange(ItemChange change, ItemChangeData const& value) override;
+
+    /** @endcond */
+
 private:
 
+    friend class CSVLoggerWriter;
+
+    /**
+     * @brief Header of a binary record queued for the writer thread, followed by the tagged values
+     */
+    struct RecordHeader {
+        qint64 time;               ///< Raw clock reading, session nanoseconds if there is a session, milliseconds since epoch otherwise
+        qint32 count;              ///< Number of values
+        quint8 precision;          ///< Number of decimal places for floating point numbers
+        quint8 flags;              ///< Combination of RecordFlag
+    };
+
+    /**
+     * @brief Flags of a binary record
+     */
+    enum RecordFlag {
+        MillisRecord = 1,          ///< Timestamp includes milliseconds
+        DoublesRecord = 2          ///< Values are untagged doubles
+    };
+
+    /**
+     * @brief Tags of the values of a binary record
+     */
+    enum RecordTag {
+        DoubleTag = 'd',           ///< Followed by a double
+        IntegerTag = 'i',          ///< Followed by a qint64
+        TrueTag = 't',             ///< Boolean true
+        FalseTag = 'f',            ///< Boolean false
+        StringTag = 's',           ///< Followed by the quint32 id of an interned string
+        NewStringTag = 'n',        ///< Followed by the quint32 id of a string to intern, then an inline string
+        InlineStringTag = 'u'      ///< Followed by a qint32 length and padding to 2 bytes, then UTF-16 code units
+    };
+
+    /**
+     * @brief Outcome of recovering an existing log file
+     */
+    enum RecoverResult {
+        Recovered,                 ///< File is absent, empty or begins with the expected header, and can be appended to
+        HeaderMismatch,            ///< File begins with another header, the log must roll over to another file
+        RecoverFailed              ///< File could not be read or repaired, e.g it is read-only or access is not granted yet
+    };
+
+    /**
+     * @brief Row kept in memory until the storage accepts it
+     */
+    struct PendingRow {
+        QByteArray bytes;          ///< Row including the trailing newline
+        qint64 time;               ///< Timestamp of the row in milliseconds since epoch, negative if not to be indexed
+        int written;               ///< Number of bytes of the row already in the file
+    };
+
     QString filename;              ///< Log's filename or full path
     QList<QString> header;         ///< Header to dump on the first line
 
@@ -184,14 +556,277 @@ private:
     bool writing;                  ///< Log is being written
 
     QFile file;                    ///< Log file
-    QTextStream writer;            ///< Log file writer
 
     bool logTime;                  ///< Whether to include timestamp as the first field when data is logged
     bool logMillis;                ///< Whether to include milliseconds in the timestamp
     bool toConsole;                ///< Log to console instead of file for debug purposes
     int precision;                 ///< Number of decimal places to print to the log for floats
+    QList<int> columnPrecision;    ///< Number of decimal places per column, negative to use precision
+    QList<qreal> columnScale;      ///< Factor per column that numbers are multiplied with
+
+    int checksumBlockSize;         ///< Approximate block size in bytes for checksums, 0 if disabled
+    QFile checksumFile;            ///< Block checksum sidecar file
+    qint64 blockOffset;            ///< Offset of the current checksum block in the log file
+    qint64 blockLength;            ///< Bytes written to the current checksum block so far
+    quint32 blockCrc;              ///< Running CRC-32 state of the current checksum block
+
+    int indexRows;                 ///< Time index entry interval in rows, 0 if disabled
+    int indexMillis;               ///< Time index entry interval in milliseconds, 0 if disabled
+    CSVLogIndex index;             ///< Time index sidecar
+    qint64 writeOffset;            ///< Current end of the log file
+
+    QByteArray lineBuffer;         ///< Reused buffer the current line is built in
+    TimestampFormatter timestampFormatter; ///< Formats and caches timestamps
+
+    int memoryBudget;              ///< Maximum number of bytes of rows kept in memory
+    OverflowPolicy overflowPolicy; ///< Which rows to drop when the memory budget is exhausted
+    qint64 minFreeSpace;           ///< Number of bytes that must remain free on the storage
+    QAtomicInt diskFull;           ///< Whether rows are kept in memory because the storage cannot be written, read from any thread
+    QAtomicInteger<qint64> droppedRows;  ///< Number of rows dropped so far, read from any thread
+    QAtomicInteger<qint64> pendingBytes; ///< Number of bytes of rows kept in memory, read from any thread
+    QQueue<PendingRow> pendingRows; ///< Rows waiting for the storage, oldest first
+    qint64 bytesSinceSpaceCheck;   ///< Bytes written since the free space was last checked
+    QElapsedTimer retryClock;      ///< Time since the storage was last tried while it is full
+
+    CoalesceMode coalesce;         ///< When to write rows
+    QMetaObject::Connection coalesceConnection; ///< Connection that writes the coalesced rows
+    QTimer coalesceTimer;          ///< Writes the coalesced rows if no frame or event loop iteration ends in time
+    QByteArray coalescedRows;      ///< Rows waiting for the end of the frame or event loop iteration
+    QVector<qint64> coalescedTimes; ///< Timestamps of the coalesced rows in milliseconds since epoch, negative if not to be indexed
+    QVector<int> coalescedEnds;    ///< End offsets of the coalesced rows in coalescedRows
+
+    bool asynchronous;             ///< Whether to format and write rows on the writer thread
+    CSVLoggerWriter* writer;       ///< Writer thread, null if not running
+    QMutex recordMutex;            ///< Protects the queued records and their reservation, the dropped record count and the stop request
+    QWaitCondition recordsQueued;  ///< Wakes the writer thread up when records are queued or it should stop
+    QByteArray queuedRecords;      ///< Binary records queued by log()
+    QByteArray writtenRecords;     ///< Binary records being written by the writer thread
+    qint64 droppedRecords;         ///< Records dropped by log() since the writer thread last counted them
+    qint64 queuedReserved;         ///< Bytes of LoggerUtil's memory budget reserved for the queued records
+    bool writerStopping;           ///< Whether the writer thread should exit once the queue is empty
+    bool sessionRecords;           ///< Whether the raw times of the records are session times
+    qint64 sessionStartMSecs;      ///< Wall clock time of the session start, for converting raw session times on the writer thread
+    QHash<QString, quint32> internedIds;  ///< Ids of the strings interned so far, used by log()
+    QVector<QByteArray> internedFields;   ///< Formatted fields of the strings interned so far, used by the writer thread
+
+    QPointer<LogSession> session;  ///< Session whose clock stamps the rows, null if the wall clock is used
 
     const QString timestampHeader; ///< Timestamp header field string
+    const QString sessionTimestampHeader; ///< Timestamp header field string when stamping with the session clock
+
+    /**
+     * @brief Resolves the filename, recovers the log file if needed and opens it for appending
+     *
+     * @return Whether the file could be opened
+     */
+    bool openFile();
+
+    /**
+     * @brief Truncates a torn last line and checks the header of an existing log file
+     *
+     * @param filename Full path of the log file to check
+     * @param headerLine Expected first line, including the trailing newline
+     * @return Whether the file can be appended to, must be rolled over or could not be recovered
+     */
+    RecoverResult recoverFile(QString const& filename, QByteArray const& headerLine);
+
+    /**
+     * @brief Finishes pending writes and closes the log file and its sidecars
+     */
+    void closeFile();
+
+    /**
+     * @brief Connects the signal that writes the coalesced rows for the window the logger is currently in
+     *
+     * Resolves `window()`; if the logger is not in a window yet, the end of event loop iteration is used even when
+     * coalescing by frame, until the scene change reconnects it.
+     */
+    void connectCoalescing();
+
+    /**
+     * @brief Connects `afterAnimating()` of the given window when coalescing by frame, the end of event loop iteration otherwise
+     *
+     * @param window Window the logger is in or is being moved into, null if none
+     */
+    void connectCoalescing(QQuickWindow* window);
+
+    /**
+     * @brief Writes the coalesced rows with a single write, keeping the rows that could not be written in memory
+     */
+    void flushCoalesced();
+
+    /**
+     * @brief Opens the file if needed and starts the writer thread if it is not running
+     *
+     * @return Whether records can be queued
+     */
+    bool startWriter();
+
+    /**
+     * @brief Waits for the writer thread to write all queued records and stops it
+     */
+    void stopWriter();
+
+    /**
+     * @brief Formats and writes records until stopped, runs on the writer thread
+     */
+    void runWriter();
+
+    /**
+     * @brief Reserves room for a record in the queue, to be called with recordMutex locked
+     *
+     * @param count Number of values
+     * @param flags Combination of RecordFlag
+     * @return Whether the record fits in the memory budget
+     */
+    bool beginRecord(int count, quint8 flags);
+
+    /**
+     * @brief Wakes the writer thread up if due after log() queued a record, and starts the coalescing deadline
+     *
+     * @param queuedBefore Number of queued record bytes before the record
+     * @param queuedAfter Number of queued record bytes after the record
+     */
+    void recordQueued(int queuedBefore, int queuedAfter);
+
+    /**
+     * @brief Appends a string value to the record being queued, interning it if it is short
+     *
+     * @param string String to append
+     */
+    void appendRecordString(QString const& string);
+
+    /**
+     * @brief Formats and writes the given binary records
+     *
+     * @param records Binary records
+     */
+    void writeRecords(QByteArray const& records);
+
+    /**
+     * @brief Writes the given bytes to the log file and updates the block checksum
+     *
+     * @param data Bytes to write
+     * @param size Number of bytes to write
+     * @return Number of bytes actually written
+     */
+    qint64 writeBytes(const char* data, qint64 size);
+
+    /**
+     * @brief Writes a row to the log file, or keeps it in memory if the storage cannot be written
+     *
+     * @param row Row to write, including the trailing newline
+     * @param time Timestamp of the row in milliseconds since epoch, negative if not to be indexed
+     */
+    void writeRow(QByteArray const& row, qint64 time);
+
+    /**
+     * @brief Keeps a row in memory within the memory budgets, dropping rows according to the overflow policy if needed
+     *
+     * @param row Row to keep, including the trailing newline
+     * @param time Timestamp of the row in milliseconds since epoch, negative if not to be indexed
+     * @param written Number of bytes of the row already in the file
+     */
+    void enqueuePending(QByteArray const& row, qint64 time, int written);
+
+    /**
+     * @brief Writes the rows kept in memory in order
+     *
+     * @return Whether all rows could be written
+     */
+    bool flushPending();
+
+    /**
+     * @brief Drops the rows kept in memory, counting them as dropped
+     */
+    void discardPending();
+
+    /**
+     * @brief Truncates the log file back to the beginning of a row that could only be partially written
+     *
+     * @param rowOffset Offset of the beginning of the row
+     */
+    void truncateTornRow(qint64 rowOffset);
+
+    /**
+     * @brief Checks whether more than minFreeSpace bytes are free on the storage of the log file
+     *
+     * @return Whether there is enough free space
+     */
+    bool hasFreeSpace();
+
+    /**
+     * @brief Sets whether rows are kept in memory, starting the retry interval
+     *
+     * @param diskFull Whether the storage cannot be written
+     */
+    void setDiskFull(bool diskFull);
+
+    /**
+     * @brief Checks the storage, opening the file if needed, and writes the rows kept in memory if it accepts them
+     */
+    void retryPending();
+
+    /**
+     * @brief Emits the given change signal on the logger's thread, queued if called from the writer thread
+     *
+     * @param signal Name of the signal
+     */
+    void notifyChanged(const char* signal);
+
+    /**
+     * @brief Opens the file if needed and writes the line in the line buffer to it, or to the console
+     *
+     * @param time Timestamp of the line in milliseconds since epoch
+     */
+    void commitLine(qint64 time);
+
+    /**
+     * @brief Gets the current time from the session clock if there is a session, from the wall clock otherwise
+     *
+     * @param sessionNanos Set to the session time in nanoseconds if there is a session
+     * @return Current time in milliseconds since epoch
+     */
+    qint64 currentTime(qint64* sessionNanos);
+
+    /**
+     * @brief Appends the timestamp field to the line buffer
+     *
+     * @param time Timestamp in milliseconds since epoch
+     * @param sessionNanos Timestamp in session nanoseconds, used if there is a session
+     */
+    void appendTimestamp(qint64 time, qint64 sessionNanos);
+
+    /**
+     * @brief Appends a number to the line buffer with the scale and precision of its column
+     *
+     * @param value Number to append
+     * @param column Index of the column, excluding the timestamp
+     * @param precision Number of decimal places if the column doesn't have its own
+     */
+    void appendNumber(double value, int column, int precision);
+
+    /**
+     * @brief Appends an integer to the line buffer, as a number with the precision of its column if the column is scaled
+     *
+     * @param value Integer to append
+     * @param column Index of the column, excluding the timestamp
+     * @param precision Number of decimal places if the column is scaled and doesn't have its own
+     */
+    void appendInteger(qint64 value, int column, int precision);
+
+    /**
+     * @brief Appends a datum to the line buffer, formatting numbers with the scale and precision of their column
+     *
+     * @param datum Datum to append
+     * @param column Index of the column, excluding the timestamp
+     */
+    void appendDatum(QVariant const& datum, int column);
+
+    /**
+     * @brief Appends the current block's checksum to the sidecar file and starts a new block
+     */
+    void finishChecksumBlock();
 
     /**
      * @brief Builds and gets the header string
@@ -201,12 +836,23 @@ private:
     QString buildHeaderString();
 
     /**
-     * @brief Builds and gets the log row
+     * @brief Builds the log row in the line buffer, without the trailing newline
      *
      * @brief data Data to log
-     * @return Log row
+     * @param time Timestamp of the row in milliseconds since epoch
+     * @param sessionNanos Timestamp of the row in session nanoseconds, used if there is a session
+     */
+    void buildLogLine(QVariantList const& data, qint64 time, qint64 sessionNanos);
+
+    /**
+     * @brief Builds the log row of numbers in the line buffer, without the trailing newline
+     *
+     * @param values Numbers to log
+     * @param count Number of values
+     * @param time Timestamp of the row in milliseconds since epoch
+     * @param sessionNanos Timestamp of the row in session nanoseconds, used if there is a session
      */
-    QString buildLogLine(QVariantList const& data);
+    void buildLogLine(const double* values, int count, qint64 time, qint64 sessionNanos);
 
 };
 
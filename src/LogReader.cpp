@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file LogReader.cpp
+ * @brief Source for a QML reader that computes statistics over CSV logs
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#include "LogReader.h"
+
+#include "CSVCodec.h"
+#include "CSVLogIndex.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QVector>
+#include <QtNumeric>
+
+#include <cstring>
+#include <limits>
+
+namespace QMLLogger{
+
+/* LogReaderWorker */
+
+bool LogReaderWorker::scan(QString const& filename, QString const& column, QDateTime const& from, QDateTime const& to, qreal progressBegin, qreal progressEnd,
+                           std::function<void(qint64, qint64, const char*, const char*, double)> const& onValue){
+    QFile log(filename);
+    if(!log.open(QIODevice::ReadOnly)){
+        emit error("LogReader: Could not open " + filename + ": " + log.errorString());
+        return false;
+    }
+
+    //Find column in header
+    QByteArray headerLine = log.readLine();
+    QList<QByteArray> fields = headerLine.trimmed().split(',');
+    QByteArray columnName = column.toUtf8();
+    int columnIndex = -1;
+    for(int i = 0; i < fields.size() && columnIndex < 0; i++)
+        if(fields[i].trimmed() == columnName)
+            columnIndex = i;
+    if(columnIndex < 0){
+        emit error("LogReader: No column named " + column + " in " + filename);
+        return false;
+    }
+
+    //Session times are relative to a LogSession whose anchors are not known here, refuse rather than ignore the range
+    bool filterTime = from.isValid() || to.isValid();
+    if(filterTime && fields[0].trimmed() != "timestamp"){
+        if(fields[0].trimmed() == "sessionNanos")
+            emit error("LogReader: " + filename + " is stamped with sessionNanos, from and to cannot be applied to it; clear them to read the whole log");
+        else
+            emit error("LogReader: " + filename + " has no timestamp column, from and to cannot be applied to it; clear them to read the whole log");
+        return false;
+    }
+
+    //Narrow down the range to read with the time index, if any
+    qint64 begin = headerLine.size();
+    qint64 end = log.size();
+    if(filterTime)
+        CSVLogIndex::findRange(filename,
+                               from.isValid() ? from.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min(),
+                               to.isValid() ? to.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max(),
+                               &begin, &end);
+    QByteArray fromKey, toKey;
+    bool keysReady = false;
+
+    //Map one window at a time, remapping from the beginning of the last incomplete line
+    const qint64 windowSize = 16 << 20;
+    qint64 window = windowSize;
+    qint64 pos = begin;
+    while(pos < end){
+        if(generation.load() != requestGeneration){
+            emit error("LogReader: Cancelled");
+            return false;
+        }
+
+        qint64 length = qMin(window, end - pos);
+        const char* data = (const char*)log.map(pos, length);
+        if(!data){
+            emit error("LogReader: Could not map " + filename + ": " + log.errorString());
+            return false;
+        }
+        const char* it = data;
+        const char* stop = data + length;
+        bool lastWindow = pos + length >= end;
+        while(it < stop){
+            const char* lineEnd = CSVCodec::findRowEnd(it, stop);
+            if(lineEnd == stop && !lastWindow)
+                break;
+
+            bool inRange = true;
+            if(filterTime){
+                if(!keysReady){
+                    const char* timeEnd;
+                    CSVCodec::findField(it, lineEnd, 0, &timeEnd);
+                    bool millis = timeEnd - it > 19;
+                    if(from.isValid())
+                        fromKey = CSVLogIndex::timestampKey(from.toMSecsSinceEpoch(), millis);
+                    if(to.isValid())
+                        toKey = CSVLogIndex::timestampKey(to.toMSecsSinceEpoch(), millis);
+                    keysReady = true;
+                }
+                if(!fromKey.isEmpty() && memcmp(it, fromKey.constData(), qMin((qint64)fromKey.size(), (qint64)(lineEnd - it))) < 0)
+                    inRange = false;
+                if(!toKey.isEmpty() && memcmp(it, toKey.constData(), qMin((qint64)toKey.size(), (qint64)(lineEnd - it))) > 0)
+                    inRange = false;
+            }
+
+            if(inRange){
+                const char* fieldEnd;
+                const char* field = CSVCodec::findField(it, lineEnd, columnIndex, &fieldEnd);
+                bool ok = false;
+                double value = field ? CSVCodec::parseDouble(field, fieldEnd, &ok) : 0;
+                if(ok && qIsFinite(value))
+                    onValue(pos - begin + (it - data), end - begin, it, lineEnd, value);
+            }
+
+            it = lineEnd + 1;
+        }
+
+        qint64 consumed = qMin((qint64)(it - data), length);
+        log.unmap((uchar*)data);
+        if(consumed == 0)
+            window *= 2; //Line longer than the window
+        else{
+            pos += consumed;
+            window = windowSize;
+        }
+        emit progressChanged(progressBegin + (progressEnd - progressBegin)*(pos - begin)/(end - begin));
+    }
+    return true;
+}
+
+void LogReaderWorker::computeStats(int generation, QString const& filename, QString const& column, QDateTime const& from, QDateTime const& to, QVariantList const& percentiles){
+    requestGeneration = generation;
+
+    //First pass: count, min, max, mean
+    qint64 count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+    auto accumulate = [&](qint64, qint64, const char*, const char*, double value){
+        count++;
+        min = qMin(min, value);
+        max = qMax(max, value);
+        sum += value;
+    };
+    if(!scan(filename, column, from, to, 0, percentiles.isEmpty() ? 1 : 0.5, accumulate))
+        return;
+
+    //Second pass: histogram for percentiles
+    QVariantList percentileValues;
+    if(count > 0 && !percentiles.isEmpty()){
+        const int bins = 65536;
+        double width = (max - min)/bins;
+        QVector<qint64> histogram(bins, 0);
+        auto bin = [&](qint64, qint64, const char*, const char*, double value){
+            histogram[qBound(0, int((value - min)/width), bins - 1)]++;
+        };
+        if(width > 0 && !scan(filename, column, from, to, 0.5, 1, bin))
+            return;
+        for(QVariant const& percentile : percentiles){
+            if(width <= 0){
+                percentileValues << min;
+                continue;
+            }
+            double rank = qBound(0.0, percentile.toDouble(), 100.0)/100.0*count;
+            qint64 cumulative = 0;
+            int i = 0;
+            for(; i < bins - 1; i++){
+                cumulative += histogram[i];
+                if(cumulative >= rank)
+                    break;
+            }
+            percentileValues << min + (i + 0.5)*width;
+        }
+    }
+
+    QVariantMap stats;
+    stats["column"] = column;
+    stats["count"] = count;
+    stats["min"] = count > 0 ? min : qQNaN();
+    stats["max"] = count > 0 ? max : qQNaN();
+    stats["mean"] = count > 0 ? sum/count : qQNaN();
+    stats["percentiles"] = percentileValues;
+    emit statsReady(stats);
+}
+
+void LogReaderWorker::downsample(int generation, QString const& filename, QString const& column, QDateTime const& from, QDateTime const& to, int points){
+    requestGeneration = generation;
+    points = qMax(1, points);
+
+    struct Bucket {
+        qint64 count = 0;
+        double min = 0;
+        double max = 0;
+        double sum = 0;
+        QByteArray time;
+    };
+    QVector<Bucket> buckets(points);
+    auto accumulate = [&](qint64 offset, qint64 size, const char* row, const char* rowEnd, double value){
+        Bucket& bucket = buckets[qMin((qint64)points - 1, offset*points/size)];
+        if(bucket.count == 0){
+            const char* timeEnd;
+            CSVCodec::findField(row, rowEnd, 0, &timeEnd);
+            bucket.time = QByteArray(row, int(timeEnd - row));
+            bucket.min = bucket.max = value;
+        }
+        bucket.count++;
+        bucket.min = qMin(bucket.min, value);
+        bucket.max = qMax(bucket.max, value);
+        bucket.sum += value;
+    };
+    if(!scan(filename, column, from, to, 0, 1, accumulate))
+        return;
+
+    QVariantList result;
+    for(Bucket const& bucket : buckets)
+        if(bucket.count > 0){
+            QVariantMap point;
+            QDateTime time = QDateTime::fromString(QString::fromLatin1(bucket.time), bucket.time.size() > 19 ? "yyyy-MM-dd HH:mm:ss.zzz" : "yyyy-MM-dd HH:mm:ss");
+            if(time.isValid())
+                point["time"] = time;
+            point["min"] = bucket.min;
+            point["max"] = bucket.max;
+            point["mean"] = bucket.sum/bucket.count;
+            point["count"] = bucket.count;
+            result << point;
+        }
+    emit downsampled(result);
+}
+
+/* LogReader */
+
+LogReader::LogReader(QQuickItem* parent) : QQuickItem(parent){
+    pendingRequests = 0;
+    progress = 0;
+
+    worker = new LogReaderWorker();
+    worker->moveToThread(&workerThread);
+    connect(&workerThread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &LogReaderWorker::progressChanged, this, &LogReader::onWorkerProgress);
+    connect(worker, &LogReaderWorker::statsReady, this, &LogReader::statsReady);
+    connect(worker, &LogReaderWorker::downsampled, this, &LogReader::downsampled);
+    connect(worker, &LogReaderWorker::error, this, &LogReader::error);
+    connect(worker, &LogReaderWorker::statsReady, this, &LogReader::onRequestDone);
+    connect(worker, &LogReaderWorker::downsampled, this, &LogReader::onRequestDone);
+    connect(worker, &LogReaderWorker::error, this, &LogReader::onRequestDone);
+    workerThread.start(QThread::LowPriority);
+}
+
+LogReader::~LogReader(){
+    worker->generation.fetchAndAddOrdered(1);
+    workerThread.quit();
+    workerThread.wait();
+}
+
+void LogReader::setFilename(QString const& filename){
+    if(this->filename != filename){
+        this->filename = filename;
+        emit filenameChanged();
+
+        QString path = filename;
+        if(!QDir(path).isAbsolute())
+            path =
+                #if defined(Q_OS_WIN)
+                    QStandardPaths::writableLocation(QStandardPaths::StandardLocation::AppDataLocation)
+                #else
+                    QStandardPaths::writableLocation(QStandardPaths::StandardLocation::DocumentsLocation)
+                #endif
+                + "/" + path;
+        resolvedFilename = path;
+
+        QStringList newHeader;
+        QFile log(resolvedFilename);
+        if(log.open(QIODevice::ReadOnly))
+            for(QString const& field : QString::fromUtf8(log.readLine()).trimmed().split(','))
+                newHeader << field.trimmed();
+        else
+            qWarning() << "LogReader::setFilename(): Could not open " + resolvedFilename + ": " + log.errorString();
+        if(header != newHeader){
+            header = newHeader;
+            emit headerChanged();
+        }
+    }
+}
+
+void LogReader::beginRequest(){
+    pendingRequests++;
+    if(pendingRequests == 1)
+        emit busyChanged();
+    progress = 0;
+    emit progressChanged();
+}
+
+void LogReader::onRequestDone(){
+    pendingRequests--;
+    if(pendingRequests == 0)
+        emit busyChanged();
+}
+
+void LogReader::onWorkerProgress(qreal progress){
+    this->progress = progress;
+    emit progressChanged();
+}
+
+void LogReader::computeStats(QString const& column, QVariantList const& percentiles){
+    beginRequest();
+    QMetaObject::invokeMethod(worker, "computeStats", Qt::QueuedConnection,
+                              Q_ARG(int, worker->generation.load()),
+                              Q_ARG(QString, resolvedFilename),
+                              Q_ARG(QString, column),
+                              Q_ARG(QDateTime, from),
+                              Q_ARG(QDateTime, to),
+                              Q_ARG(QVariantList, percentiles));
+}
+
+void LogReader::downsample(QString const& column, int points){
+    beginRequest();
+    QMetaObject::invokeMethod(worker, "downsample", Qt::QueuedConnection,
+                              Q_ARG(int, worker->generation.load()),
+                              Q_ARG(QString, resolvedFilename),
+                              Q_ARG(QString, column),
+                              Q_ARG(QDateTime, from),
+                              Q_ARG(QDateTime, to),
+                              Q_ARG(int, points));
+}
+
+void LogReader::cancel(){
+    worker->generation.fetchAndAddOrdered(1);
+}
+
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file LogReader.h
+ * @brief Header for a QML reader that computes statistics over CSV logs
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#ifndef LOGREADER_H
+#define LOGREADER_H
+
+#include <QQuickItem>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QVariant>
+#include <QThread>
+#include <QAtomicInt>
+
+#include <functional>
+
+namespace QMLLogger{
+
+/** @cond DO_NOT_DOCUMENT */
+
+/**
+ * @brief Does the actual reading of a LogReader on a worker thread
+ */
+class LogReaderWorker : public QObject {
+    /* *INDENT-OFF* */
+    Q_OBJECT
+    /* *INDENT-ON* */
+
+public:
+
+    QAtomicInt generation; ///< Incremented to cancel all requests sent with an older generation
+
+signals:
+
+    /**
+     * @brief Emitted regularly while reading
+     *
+     * @param progress Progress of the current request, between 0 and 1
+     */
+    void progressChanged(qreal progress);
+
+    /**
+     * @brief Emitted when a statistics request is done
+     *
+     * @param stats Computed statistics
+     */
+    void statsReady(QVariantMap const& stats);
+
+    /**
+     * @brief Emitted when a downsampling request is done
+     *
+     * @param points Downsampled points
+     */
+    void downsampled(QVariantList const& points);
+
+    /**
+     * @brief Emitted when a request fails or is cancelled
+     *
+     * @param message Error message
+     */
+    void error(QString const& message);
+
+public slots:
+
+    /**
+     * @brief Computes the statistics of a column, see LogReader::computeStats()
+     */
+    void computeStats(int generation, QString const& filename, QString const& column, QDateTime const& from, QDateTime const& to, QVariantList const& percentiles);
+
+    /**
+     * @brief Downsamples a column, see LogReader::downsample()
+     */
+    void downsample(int generation, QString const& filename, QString const& column, QDateTime const& from, QDateTime const& to, int points);
+
+private:
+
+    int requestGeneration; ///< Generation of the request being processed
+
+    /**
+     * @brief Calls the given function with every valid value of a column between the given times
+     *
+     * The log is memory mapped one window at a time, so it can be much larger than the available memory.
+     *
+     * @param filename Full path of the log
+     * @param column Name of the column
+     * @param from Beginning of the time range, unbounded if invalid
+     * @param to End of the time range, unbounded if invalid
+     * @param progressBegin Progress to report at the beginning of the scan
+     * @param progressEnd Progress to report at the end of the scan
+     * @param onValue Called with the byte offset of the row relative to the scanned range, the size of the scanned range, the row and the value
+     * @return Whether the whole range was scanned, emits error() if not
+     */
+    bool scan(QString const& filename, QString const& column, QDateTime const& from, QDateTime const& to, qreal progressBegin, qreal progressEnd,
+              std::function<void(qint64, qint64, const char*, const char*, double)> const& onValue);
+
+};
+
+/** @endcond */
+
+/**
+ * @brief Computes statistics over logs written by CSVLogger, on a worker thread.
+ *
+ * The log is memory mapped in windows and never loaded whole, so it can be much larger than the available memory. If
+ * the log has a time index (see CSVLogger's `indexRows` and `indexMillis`), only the part of the log within `from` and
+ * `to` is read. `from` and `to` require a `timestamp` column; requests on logs stamped with `sessionNanos` (see
+ * LogSession) or without time fail with `error()` while either is set.
+ *
+ * Requests are processed in order on a worker thread; `progress` is updated while they run and `statsReady()`,
+ * `downsampled()` or `error()` is emitted when each is done.
+ */
+class LogReader : public QQuickItem {
+    /* *INDENT-OFF* */
+    Q_OBJECT
+    /* *INDENT-ON* */
+
+    /** @brief Log filename; if full path is not given, it is looked for in the default documents directory */
+    Q_PROPERTY(QString filename WRITE setFilename READ getFilename NOTIFY filenameChanged)
+
+    /** @brief Header fields of the log, including the timestamp if present, read-only */
+    Q_PROPERTY(QStringList header READ getHeader NOTIFY headerChanged)
+
+    /** @brief Only consider rows at or after this time, unbounded if invalid, default invalid */
+    Q_PROPERTY(QDateTime from MEMBER from)
+
+    /** @brief Only consider rows at or before this time, unbounded if invalid, default invalid */
+    Q_PROPERTY(QDateTime to MEMBER to)
+
+    /** @brief Whether requests are being processed, read-only */
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+
+    /** @brief Progress of the current request between `0` and `1`, read-only */
+    Q_PROPERTY(qreal progress READ getProgress NOTIFY progressChanged)
+
+public:
+
+    /** @cond DO_NOT_DOCUMENT */
+
+    /**
+     * @brief Creates a new LogReader with the given QML parent
+     *
+     * @param parent The QML parent
+     */
+    LogReader(QQuickItem* parent = 0);
+
+    /**
+     * @brief Cancels pending requests and destroys this LogReader
+     */
+    ~LogReader();
+
+    /**
+     * @brief Sets the file name and reads the header
+     *
+     * @param filename The new filename, or full path
+     */
+    void setFilename(QString const& filename);
+
+    /**
+     * @brief Gets the filename
+     *
+     * @return The filename
+     */
+    QString getFilename(){ return filename; }
+
+    /**
+     * @brief Gets the header
+     *
+     * @return The header
+     */
+    QStringList getHeader(){ return header; }
+
+    /**
+     * @brief Gets whether requests are being processed
+     *
+     * @return Whether requests are being processed
+     */
+    bool isBusy(){ return pendingRequests > 0; }
+
+    /**
+     * @brief Gets the progress of the current request
+     *
+     * @return Progress between 0 and 1
+     */
+    qreal getProgress(){ return progress; }
+
+    /** @endcond */
+
+signals:
+
+    /** @cond DO_NOT_DOCUMENT */
+
+    /**
+     * @brief Emitted when filename changes
+     */
+    void filenameChanged();
+
+    /**
+     * @brief Emitted when the header changes
+     */
+    void headerChanged();
+
+    /**
+     * @brief Emitted when busy changes
+     */
+    void busyChanged();
+
+    /**
+     * @brief Emitted when progress changes
+     */
+    void progressChanged();
+
+    /** @endcond */
+
+    /**
+     * @brief Emitted when a computeStats() request is done
+     *
+     * @param stats Map with `column`, `count`, `min`, `max`, `mean` and `percentiles`, a list in the same order as requested
+     */
+    void statsReady(QVariantMap stats);
+
+    /**
+     * @brief Emitted when a downsample() request is done
+     *
+     * @param points List of maps with `time` (Date, if there is a timestamp column), `min`, `max`, `mean` and `count`
+     */
+    void downsampled(QVariantList points);
+
+    /**
+     * @brief Emitted when a request fails or is cancelled
+     *
+     * @param message Error message
+     */
+    void error(QString message);
+
+public slots:
+
+    /**
+     * @brief Computes count, min, max, mean and percentiles of the numeric values of a column
+     *
+     * Percentiles are computed with a second pass over a 65536 bin histogram between min and max, so they are
+     * accurate to (max - min)/65536.
+     *
+     * @param column Name of the column
+     * @param percentiles Percentiles to compute, between 0 and 100, default `[50, 90, 99]`
+     */
+    void computeStats(QString const& column, QVariantList const& percentiles = QVariantList() << 50 << 90 << 99);
+
+    /**
+     * @brief Downsamples a column to at most the given number of points for plotting
+     *
+     * Rows are bucketed evenly by their position in the log; each point carries the time of the first row in its bucket.
+     *
+     * @param column Name of the column
+     * @param points Maximum number of points
+     */
+    void downsample(QString const& column, int points);
+
+    /**
+     * @brief Cancels all requests that are being processed or waiting
+     */
+    void cancel();
+
+private slots:
+
+    /**
+     * @brief Updates progress from the worker
+     *
+     * @param progress New progress
+     */
+    void onWorkerProgress(qreal progress);
+
+    /**
+     * @brief Accounts for a finished request
+     */
+    void onRequestDone();
+
+private:
+
+    QString filename;           ///< Log's filename or full path
+    QString resolvedFilename;   ///< Log's full path
+    QStringList header;         ///< Header fields of the log
+    QDateTime from;             ///< Beginning of the time range
+    QDateTime to;               ///< End of the time range
+
+    int pendingRequests;        ///< Number of requests sent to the worker and not done yet
+    qreal progress;             ///< Progress of the current request
+
+    QThread workerThread;       ///< Thread the worker lives in
+    LogReaderWorker* worker;    ///< Worker that does the reading
+
+    /**
+     * @brief Starts a new request
+     */
+    void beginRequest();
+
+};
+
+}
+
+#endif /* LOGREADER_H */
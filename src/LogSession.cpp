@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file LogSession.cpp
+ * @brief Source for a monotonic time base shared by several loggers
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#include "LogSession.h"
+
+#include <QDir>
+#include <QStandardPaths>
+#include <QMutexLocker>
+
+namespace QMLLogger{
+
+namespace{
+
+const QByteArray anchorHeader("sessionNanos, wallClock\n"); ///< First line of anchor files
+
+}
+
+LogSession::LogSession(QQuickItem* parent) : QQuickItem(parent){
+    fileNeedsReopen = false;
+
+    startMSecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    clock.start();
+
+    anchorTimer.setInterval(10000);
+    connect(&anchorTimer, &QTimer::timeout, this, &LogSession::writeAnchor);
+}
+
+LogSession::~LogSession(){
+    writeAnchor();
+    file.close();
+}
+
+void LogSession::setFilename(QString const& filename){
+    if(this->filename != filename){
+        file.close();
+
+        this->filename = filename;
+
+        fileNeedsReopen = true;
+
+        emit filenameChanged();
+
+        if(filename.isEmpty())
+            anchorTimer.stop();
+        else{
+            writeAnchor();
+            anchorTimer.start();
+        }
+    }
+}
+
+void LogSession::setAnchorInterval(int anchorInterval){
+    if(anchorTimer.interval() != anchorInterval){
+        anchorTimer.setInterval(anchorInterval);
+        emit anchorIntervalChanged();
+    }
+}
+
+bool LogSession::claimFile(QString const& filename, bool empty){
+    QMutexLocker locker(&claimMutex);
+    if(claimedFiles.contains(filename))
+        return true;
+    if(!empty)
+        return false;
+    claimedFiles.insert(filename);
+    return true;
+}
+
+void LogSession::writeAnchor(){
+    if(filename.isEmpty())
+        return;
+
+    qint64 nanos = clock.nsecsElapsed();
+    QDateTime wallClock = QDateTime::currentDateTime();
+
+    //File needs re-opening
+    if(fileNeedsReopen){
+        QDir dir(filename);
+        if(dir.isAbsolute())
+            qDebug() << "LogSession::writeAnchor(): Opening " + filename + " to write anchors.";
+        else{
+            filename =
+                #if defined(Q_OS_WIN)
+                    QStandardPaths::writableLocation(QStandardPaths::StandardLocation::AppDataLocation)
+                #else
+                    QStandardPaths::writableLocation(QStandardPaths::StandardLocation::DocumentsLocation)
+                #endif
+                + "/" + filename;
+            qDebug() << "LogSession::writeAnchor(): Absolute path not given, opening " + filename + " to write anchors.";
+            emit filenameChanged();
+        }
+        QDir::root().mkpath(QFileInfo(filename).absolutePath());
+
+        //Session times restart at 0 with every session, so anchors of another session must not be appended to
+        QFileInfo info(filename);
+        QString suffix = info.suffix();
+        QString candidate = filename;
+        for(int i = 1; !claimFile(candidate, QFileInfo(candidate).size() <= anchorHeader.size()); i++){
+            if(i > 1000){
+                qCritical() << "LogSession::writeAnchor(): Could not find a file to roll over to after " + filename;
+                return;
+            }
+            candidate = info.absolutePath() + "/" + info.completeBaseName() + "-" + QString::number(i) + (suffix.isEmpty() ? "" : "." + suffix);
+        }
+        if(candidate != filename){
+            qWarning() << "LogSession::writeAnchor(): " + filename + " holds anchors of another session, rolling over to " + candidate;
+            filename = candidate;
+            emit filenameChanged();
+        }
+
+        file.setFileName(filename);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)){
+            qCritical() << "LogSession::writeAnchor(): Could not open file: " << file.errorString();
+            return;
+        }
+
+        fileNeedsReopen = false;
+
+        if(file.size() == 0)
+            file.write(anchorHeader);
+    }
+
+    if(file.isOpen())
+        file.write(QByteArray::number(nanos) + ", " + wallClock.toString("yyyy-MM-dd HH:mm:ss.zzz").toUtf8() + "\n");
+}
+
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2016 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file LogSession.h
+ * @brief Header for a monotonic time base shared by several loggers
+ * @author Ayberk Özgür
+ * @date 2026-10-19
+ */
+
+#ifndef LOGSESSION_H
+#define LOGSESSION_H
+
+#include <QQuickItem>
+#include <QString>
+#include <QFile>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QMutex>
+#include <QSet>
+
+namespace QMLLogger{
+
+/**
+ * @brief Monotonic time base shared by several loggers, so that their rows can be ordered and joined reliably.
+ *
+ * A CSVLogger whose `session` is set stamps its rows with the nanoseconds elapsed since the session started, in a
+ * `sessionNanos` column, instead of the wall clock. This clock is monotonic and common to all loggers of the session,
+ * so it neither drifts between loggers nor jumps when the wall clock is adjusted (e.g by NTP).
+ *
+ * If `filename` is given, wall clock anchors are appended to it every `anchorInterval` milliseconds as follows, so that
+ * session times can be mapped back to wall clock times:
+ *
+ * ```
+ *     sessionNanos, wallClock
+ *     session time in nanoseconds, wall clock time in yyyy-MM-dd HH:mm:ss.zzz format
+ * ```
+ *
+ * Session times restart at 0 with every session, e.g every run of the app. So that they never go backwards within a
+ * file, the anchor file and the logs stamped by a session are only appended to by that session: existing ones that
+ * already hold times of another session roll over to the first of `name-1.ext`, `name-2.ext`, ... that does not.
+ *
+ * The logs of a session can be merged by time with the `log-merge` tool.
+ */
+class LogSession : public QQuickItem {
+    /* *INDENT-OFF* */
+    Q_OBJECT
+    /* *INDENT-ON* */
+
+    /** @brief Anchor filename, no anchors are written if empty; if full path is not given, file will be put in default documents directory */
+    Q_PROPERTY(QString filename WRITE setFilename READ getFilename NOTIFY filenameChanged)
+
+    /** @brief Interval between wall clock anchors in milliseconds, default `10000` */
+    Q_PROPERTY(int anchorInterval WRITE setAnchorInterval READ getAnchorInterval NOTIFY anchorIntervalChanged)
+
+    /** @brief Wall clock time at which the session started, read-only */
+    Q_PROPERTY(QDateTime startTime READ getStartTime CONSTANT)
+
+public:
+
+    /** @cond DO_NOT_DOCUMENT */
+
+    /**
+     * @brief Creates and starts a new LogSession with the given QML parent
+     *
+     * @param parent The QML parent
+     */
+    LogSession(QQuickItem* parent = 0);
+
+    /**
+     * @brief Writes a last anchor and destroys this LogSession
+     */
+    ~LogSession();
+
+    /**
+     * @brief Sets the anchor file name and writes an anchor to it
+     *
+     * @param filename The new filename, or full path
+     */
+    void setFilename(QString const& filename);
+
+    /**
+     * @brief Gets the anchor filename
+     *
+     * @return The anchor filename
+     */
+    QString getFilename(){ return filename; }
+
+    /**
+     * @brief Sets the interval between wall clock anchors
+     *
+     * @param anchorInterval The new interval in milliseconds
+     */
+    void setAnchorInterval(int anchorInterval);
+
+    /**
+     * @brief Gets the interval between wall clock anchors
+     *
+     * @return The interval in milliseconds
+     */
+    int getAnchorInterval(){ return anchorTimer.interval(); }
+
+    /**
+     * @brief Gets the wall clock time at which the session started
+     *
+     * @return The start time
+     */
+    QDateTime getStartTime(){ return QDateTime::fromMSecsSinceEpoch(startMSecsSinceEpoch); }
+
+    /**
+     * @brief Gets the session time, thread-safe
+     *
+     * @return Nanoseconds elapsed since the session started
+     */
+    qint64 elapsedNanos() const { return clock.nsecsElapsed(); }
+
+    /**
+     * @brief Converts a session time to milliseconds since epoch, based on the start time; never goes backwards
+     *
+     * @param nanos Session time in nanoseconds
+     * @return Milliseconds since epoch, -1 if nanos is negative and thus not a time of this session
+     */
+    qint64 toMSecsSinceEpoch(qint64 nanos) const { return nanos < 0 ? -1 : startMSecsSinceEpoch + nanos/1000000; }
+
+    /**
+     * @brief Claims a file for the times of this session if it holds no times of another session, thread-safe
+     *
+     * @param filename Full path of the file
+     * @param empty Whether the file holds no times, i.e does not exist or only has a header
+     * @return Whether the file was already claimed by this session or was empty and is now
+     */
+    bool claimFile(QString const& filename, bool empty);
+
+    /** @endcond */
+
+signals:
+
+    /** @cond DO_NOT_DOCUMENT */
+
+    /**
+     * @brief Emitted when filename changes
+     */
+    void filenameChanged();
+
+    /**
+     * @brief Emitted when anchorInterval changes
+     */
+    void anchorIntervalChanged();
+
+    /** @endcond */
+
+public slots:
+
+    /**
+     * @brief Appends a wall clock anchor to the anchor file now
+     */
+    void writeAnchor();
+
+private:
+
+    QString filename;               ///< Anchor filename or full path
+    QFile file;                     ///< Anchor file
+    bool fileNeedsReopen;           ///< Filename changed and file needs reopening
+
+    QElapsedTimer clock;            ///< Monotonic session clock
+    qint64 startMSecsSinceEpoch;    ///< Wall clock time at which the clock started
+    QTimer anchorTimer;             ///< Triggers periodic anchors
+
+    QMutex claimMutex;              ///< Protects claimedFiles
+    QSet<QString> claimedFiles;     ///< Full paths of the files that hold times of this session
+
+};
+
+}
+
+#endif /* LOGSESSION_H */
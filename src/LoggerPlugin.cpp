@@ -27,10 +27,17 @@
 #include "LoggerUtil.h"
 #include "SimpleLogger.h"
 #include "CSVLogger.h"
+#include "LogReader.h"
+#include "LogSession.h"
+
+#include <QElapsedTimer>
 
 namespace QMLLogger{
 
 void LoggerPlugin::registerTypes(const char* uri){
+    QElapsedTimer timer;
+    timer.start();
+
     qmlRegisterSingletonType<LoggerUtil>(uri, 1, 0, "LoggerUtil",
                                                [] (QQmlEngine* qmlEngine, QJSEngine* jsEngine)->QObject* {
                                                    Q_UNUSED(qmlEngine)
@@ -39,6 +46,10 @@ void LoggerPlugin::registerTypes(const char* uri){
                                                });
     qmlRegisterType<SimpleLogger>(uri, 1, 0, "SimpleLogger");
     qmlRegisterType<CSVLogger>(uri, 1, 0, "CSVLogger");
+    qmlRegisterType<LogReader>(uri, 1, 0, "LogReader");
+    qmlRegisterType<LogSession>(uri, 1, 0, "LogSession");
+
+    qCDebug(loggerStartup) << "LoggerPlugin::registerTypes(): Registered types in" << timer.nsecsElapsed()/1000 << "us";
 }
 
 }
@@ -27,6 +27,10 @@
 #include<QSysInfo>
 #include<QBluetoothLocalDevice>
 #include<QNetworkInterface>
+#include<QMutex>
+#include<QMutexLocker>
+#include<QAtomicInteger>
+#include<QElapsedTimer>
 
 #ifdef ANDROID
     #include <QtAndroid>
@@ -34,11 +38,89 @@
 
 namespace QMLLogger{
 
+Q_LOGGING_CATEGORY(loggerStartup, "qml-logger.startup", QtInfoMsg)
+
+namespace{
+
+QMutex messageSinkMutex;                        ///< Protects the variables below, never locked twice by a thread thanks to inMessageHandler
+SimpleLogger* messageSink = nullptr;            ///< Logger that receives Qt messages, null if not capturing
+bool messageEcho = false;                       ///< Whether to pass messages to the previous handler as well
+QtMessageHandler previousMessageHandler = nullptr; ///< Handler that was installed before capturing
+thread_local bool inMessageHandler = false;     ///< Whether the current thread is inside messageHandler()
+thread_local QtMessageHandler handlingPrevious = nullptr; ///< Previous handler for messages emitted inside messageHandler()
+
+QAtomicInteger<qint64> memoryBudget(16*1024*1024); ///< Global budget for bytes waiting for storage
+QAtomicInteger<qint64> pendingBytes(0);         ///< Bytes waiting for storage in all loggers
+
+/**
+ * @brief Routes a Qt message to the capturing logger on its thread
+ */
+void messageHandler(QtMsgType type, QMessageLogContext const& context, QString const& message){
+    //Messages emitted while handling one go straight to the previous handler, without locking the mutex again
+    if(inMessageHandler){
+        if(handlingPrevious)
+            handlingPrevious(type, context, message);
+        return;
+    }
+
+    QMutexLocker locker(&messageSinkMutex);
+    QtMessageHandler previous = previousMessageHandler;
+
+    //Messages emitted while logging go straight to the previous handler to avoid loops
+    if(!messageSink || SimpleLogger::isWritingInCurrentThread()){
+        locker.unlock();
+        if(previous)
+            previous(type, context, message);
+        return;
+    }
+    inMessageHandler = true;
+    handlingPrevious = previous;
+
+    SimpleLogger::Level level;
+    const char* slot;
+    switch(type){
+        case QtDebugMsg:
+            level = SimpleLogger::Debug;
+            slot = "debug";
+            break;
+        case QtInfoMsg:
+            level = SimpleLogger::Info;
+            slot = "info";
+            break;
+        case QtWarningMsg:
+            level = SimpleLogger::Warn;
+            slot = "warn";
+            break;
+        default:
+            level = SimpleLogger::Error;
+            slot = "error";
+            break;
+    }
+    if(messageSink->isLogging(level))
+        QMetaObject::invokeMethod(messageSink, slot, Qt::QueuedConnection, Q_ARG(QString, qFormatLogMessage(type, context, message)));
+    bool echo = messageEcho || type == QtFatalMsg;
+
+    inMessageHandler = false;
+    locker.unlock();
+    if(echo && previous)
+        previous(type, context, message);
+}
+
+}
+
 LoggerUtil::LoggerUtil(QQuickItem* parent) : QQuickItem(parent){ }
 
 LoggerUtil::~LoggerUtil(){ }
 
 QString LoggerUtil::getUniqueDeviceID(){
+    static const QString deviceId = probeUniqueDeviceID();
+    return deviceId;
+}
+
+QString LoggerUtil::probeUniqueDeviceID(){
+    QElapsedTimer timer;
+    timer.start();
+
     QString deviceId = QSysInfo::prettyProductName();
 
     QString macAddr("");
@@ -85,6 +167,7 @@ QString LoggerUtil::getUniqueDeviceID(){
         qWarning() << "LoggerUtil::uniqueDeviceID(): Couldn't get any MAC address of device, device ID won't be unique!";
 
     deviceId.replace(" ", "_");
+    qCDebug(loggerStartup) << "LoggerUtil::probeUniqueDeviceID(): Probed device ID in" << timer.nsecsElapsed()/1000 << "us";
     return deviceId;
 }
 
@@ -106,4 +189,70 @@ bool LoggerUtil::androidSyncPermission(QString const& permission){
 #endif
 }
 
+void LoggerUtil::requestStoragePermissions(){
+#ifdef ANDROID
+    static QAtomicInt requested(0);
+    if(!requested.testAndSetOrdered(0, 1))
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    QStringList permissions;
+    for(QString const& permission : { QString("android.permission.WRITE_EXTERNAL_STORAGE"), QString("android.permission.READ_EXTERNAL_STORAGE") })
+        if(QtAndroid::checkPermission(permission) == QtAndroid::PermissionResult::Denied)
+            permissions << permission;
+    if(!permissions.isEmpty())
+        QtAndroid::requestPermissions(permissions, [](QtAndroid::PermissionResultMap const& results){
+            for(auto it = results.constBegin(); it != results.constEnd(); ++it)
+                if(it.value() == QtAndroid::PermissionResult::Denied)
+                    qCritical() << "LoggerUtil::requestStoragePermissions(): " + it.key() + " denied, logging outside of the app's directories will not work!";
+        });
+    qCDebug(loggerStartup) << "LoggerUtil::requestStoragePermissions(): Checked permissions in" << timer.nsecsElapsed()/1000 << "us";
+#endif
+}
+
+void LoggerUtil::setMemoryBudget(qint64 budget){
+    if(memoryBudget.fetchAndStoreOrdered(budget) != budget)
+        emit memoryBudgetChanged();
+}
+
+qint64 LoggerUtil::getMemoryBudget(){
+    return memoryBudget.load();
+}
+
+bool LoggerUtil::reservePendingBytes(qint64 bytes, bool force){
+    if(force){
+        pendingBytes.fetchAndAddOrdered(bytes);
+        return true;
+    }
+    qint64 current = pendingBytes.load();
+    do{
+        if(current + bytes > memoryBudget.load())
+            return false;
+    } while(!pendingBytes.testAndSetOrdered(current, current + bytes, current));
+    return true;
+}
+
+void LoggerUtil::releasePendingBytes(qint64 bytes){
+    pendingBytes.fetchAndAddOrdered(-bytes);
+}
+
+void LoggerUtil::captureQtMessages(SimpleLogger* logger, bool echo){
+    QMutexLocker locker(&messageSinkMutex);
+    if(logger && !messageSink)
+        previousMessageHandler = qInstallMessageHandler(messageHandler);
+    else if(!logger && messageSink)
+        qInstallMessageHandler(previousMessageHandler);
+    messageSink = logger;
+    messageEcho = echo;
+}
+
+void LoggerUtil::releaseQtMessages(SimpleLogger* logger){
+    QMutexLocker locker(&messageSinkMutex);
+    if(logger && logger == messageSink){
+        qInstallMessageHandler(previousMessageHandler);
+        messageSink = nullptr;
+    }
+}
+
 }
@@ -27,9 +27,21 @@
 
 #include<QQuickItem>
 #include<QString>
+#include<QLoggingCategory>
+
+#include "SimpleLogger.h"
 
 namespace QMLLogger{
 
+/** @cond DO_NOT_DOCUMENT */
+
+/**
+ * @brief Category for startup timings, enable with `QT_LOGGING_RULES="qml-logger.startup.debug=true"`
+ */
+Q_DECLARE_LOGGING_CATEGORY(loggerStartup)
+
+/** @endcond */
+
 /**
  * @brief Logger utilities
  * @singleton
@@ -44,6 +56,11 @@ class LoggerUtil : public QQuickItem {
      */
     Q_PROPERTY(QString uniqueDeviceID CONSTANT READ getUniqueDeviceID)
 
+    /**
+     * @brief Maximum number of bytes all loggers together may hold in memory while their storage cannot be written, default 16 MiB
+     */
+    Q_PROPERTY(qint64 memoryBudget WRITE setMemoryBudget READ getMemoryBudget NOTIFY memoryBudgetChanged)
+
 public:
 
     /** @cond DO_NOT_DOCUMENT */
@@ -68,6 +85,56 @@ public:
      */
     static bool androidSyncPermission(QString const& permission);
 
+    /**
+     * @brief Asynchronously requests the Android storage permissions that are not given yet, once per process
+     *
+     * Called by the loggers when they first open a file; returns immediately on subsequent calls and on non-Android
+     * platforms. Files opened before the user answers the permission dialog may fail to open outside of the app's own
+     * directories; the loggers try to open them again on the next log.
+     */
+    static void requestStoragePermissions();
+
+    /**
+     * @brief Sets the global memory budget for rows waiting for storage
+     *
+     * @param budget New budget in bytes
+     */
+    void setMemoryBudget(qint64 budget);
+
+    /**
+     * @brief Gets the global memory budget for rows waiting for storage
+     *
+     * @return Budget in bytes
+     */
+    static qint64 getMemoryBudget();
+
+    /**
+     * @brief Reserves room for bytes waiting for storage within the global memory budget, thread safe
+     *
+     * @param bytes Number of bytes to reserve
+     * @param force Whether to reserve the bytes even if they exceed the budget
+     * @return Whether the bytes fit in the budget and were reserved
+     */
+    static bool reservePendingBytes(qint64 bytes, bool force = false);
+
+    /**
+     * @brief Releases bytes previously reserved with reservePendingBytes(), thread safe
+     *
+     * @param bytes Number of bytes to release
+     */
+    static void releasePendingBytes(qint64 bytes);
+
+    /** @endcond */
+
+signals:
+
+    /** @cond DO_NOT_DOCUMENT */
+
+    /**
+     * @brief Emitted when the global memory budget changes
+     */
+    void memoryBudgetChanged();
+
     /** @endcond */
 
 public slots:
@@ -75,7 +142,7 @@ public slots:
     /** @cond DO_NOT_DOCUMENT */
 
     /**
-     * @brief Gets the unique device ID
+     * @brief Gets the unique device ID, probed on the first call and cached for the lifetime of the process
      *
      * @return Unique device ID (without spaces) if possible, non-unique ID if not
      */
@@ -83,6 +150,36 @@ public slots:
 
     /** @endcond */
 
+    /**
+     * @brief Routes all Qt messages (qDebug(), qInfo(), qWarning(), qCritical(), qFatal()) to the given logger
+     *
+     * Messages are formatted with qFormatLogMessage() and logged with the level matching their type, asynchronously on
+     * the logger's thread, so this is safe to use from any thread. Messages below the logger's `minLevel` are dropped
+     * before being formatted. Messages emitted by a SimpleLogger while it is writing go to the previous handler only,
+     * so the logger's own warnings cannot loop back into it. Fatal messages always go to the previous handler as well,
+     * since the application aborts before the logger gets to them.
+     *
+     * @param logger Logger to route messages to, null to stop capturing and restore the previous handler
+     * @param echo Whether to also pass messages to the previous handler, e.g to still see them on stderr or logcat
+     */
+    static void captureQtMessages(SimpleLogger* logger, bool echo = false);
+
+    /**
+     * @brief Stops routing Qt messages to the given logger if it is the one capturing them
+     *
+     * @param logger Logger that should not receive messages anymore
+     */
+    static void releaseQtMessages(SimpleLogger* logger);
+
+private:
+
+    /**
+     * @brief Probes the unique device ID, may take several milliseconds
+     *
+     * @return Unique device ID (without spaces) if possible, non-unique ID if not
+     */
+    static QString probeUniqueDeviceID();
+
 };
 
 }
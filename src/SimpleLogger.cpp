@@ -27,47 +27,77 @@
 #include <QDir>
 #include <QStandardPaths>
 #include <QDateTime>
+#include <QElapsedTimer>
 
 #include "LoggerUtil.h"
 
+#if defined(Q_OS_UNIX)
+    #include <unistd.h>
+#elif defined(Q_OS_WIN)
+    #include <io.h>
+#endif
+
 namespace QMLLogger{
 
+namespace{
+
+const int maxUnopenedBytes = 256*1024; ///< Maximum number of bytes of lines kept while the file cannot be opened
+
+thread_local int writingDepth = 0; ///< Number of SimpleLoggers writing a line in the current thread
+
+/**
+ * @brief Marks the current thread as writing a line for its lifetime
+ */
+struct WritingGuard {
+    WritingGuard(){ writingDepth++; }
+    ~WritingGuard(){ writingDepth--; }
+};
+
+}
+
 SimpleLogger::SimpleLogger(QQuickItem* parent) : QQuickItem(parent){
     logTime = true;
     logMillis = true;
     logDeviceInfo = true;
     toConsole = false;
+    minLevel = Debug;
+    flushOnError = false;
 
     fileNeedsReopen = false;
     appendDisabled=false;
+    unopenedDropped = 0;
 
-    deviceId = "[" + LoggerUtil::getUniqueDeviceID() + "] ";
+    lineBuffer.reserve(1024);
 
-    LoggerUtil::androidSyncPermission("android.permission.WRITE_EXTERNAL_STORAGE");
-    LoggerUtil::androidSyncPermission("android.permission.READ_EXTERNAL_STORAGE");
+    updateLoggedLevel();
+    connect(this, SIGNAL(enabledChanged()), this, SLOT(updateLoggedLevel()));
 }
 
 SimpleLogger::~SimpleLogger(){
-    writer.flush();
+    LoggerUtil::releaseQtMessages(this);
     file.close();
 }
 
-inline QString SimpleLogger::linePrefix(){
-    QString res = "";
+bool SimpleLogger::isWritingInCurrentThread(){
+    return writingDepth > 0;
+}
+
+inline void SimpleLogger::beginLine(){
+    lineBuffer.resize(0);
     if(logTime){
-        if(logMillis)
-            res += "[" + QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz") + "] ";
-        else
-            res += "[" + QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss") + "] ";
+        lineBuffer.append('[');
+        timestampFormatter.append(lineBuffer, QDateTime::currentMSecsSinceEpoch(), logMillis);
+        lineBuffer.append("] ", 2);
+    }
+    if(logDeviceInfo){
+        if(deviceId.isEmpty())
+            deviceId = ("[" + LoggerUtil::getUniqueDeviceID() + "] ").toUtf8();
+        lineBuffer.append(deviceId);
     }
-    if(logDeviceInfo)
-        res += deviceId;
-    return res;
 }
 
 void SimpleLogger::setFilename(const QString& filename){
     if(this->filename != filename){
-        writer.flush();
         file.close();
 
         this->filename = filename;
@@ -78,17 +108,81 @@ void SimpleLogger::setFilename(const QString& filename){
     }
 }
 
+void SimpleLogger::setMinLevel(Level minLevel){
+    this->minLevel = minLevel;
+    updateLoggedLevel();
+}
+
+void SimpleLogger::updateLoggedLevel(){
+    loggedLevel.store(isEnabled() ? minLevel : Error + 1);
+}
+
 void SimpleLogger::log(const QString& data){
-    if(!isEnabled())
+    if(!isLogging(Info))
+        return;
+
+    beginLine();
+    int from = lineBuffer.size();
+    CSVCodec::appendUtf8(lineBuffer, data);
+    CSVCodec::escapeLineBreaks(lineBuffer, from);
+    commitLine();
+}
+
+void SimpleLogger::log(const char* data, int length){
+    if(!isLogging(Info))
         return;
 
+    beginLine();
+    int from = lineBuffer.size();
+    lineBuffer.append(data, length < 0 ? int(qstrlen(data)) : length);
+    CSVCodec::escapeLineBreaks(lineBuffer, from);
+    commitLine();
+}
+
+void SimpleLogger::debug(const QString& data){
+    if(isLogging(Debug))
+        logTagged(Debug, data);
+}
+
+void SimpleLogger::info(const QString& data){
+    if(isLogging(Info))
+        logTagged(Info, data);
+}
+
+void SimpleLogger::warn(const QString& data){
+    if(isLogging(Warn))
+        logTagged(Warn, data);
+}
+
+void SimpleLogger::error(const QString& data){
+    if(isLogging(Error))
+        logTagged(Error, data);
+}
+
+void SimpleLogger::logTagged(Level level, const QString& data){
+    static const char* const tags[] = { "[DEBUG] ", "[INFO] ", "[WARN] ", "[ERROR] " };
+    beginLine();
+    lineBuffer.append(tags[level]);
+    int from = lineBuffer.size();
+    CSVCodec::appendUtf8(lineBuffer, data);
+    CSVCodec::escapeLineBreaks(lineBuffer, from);
+    commitLine(level);
+}
+
+void SimpleLogger::commitLine(Level level){
+    WritingGuard guard;
+
     if(toConsole){
-        qDebug() << linePrefix() + data;
+        qDebug() << QString::fromUtf8(lineBuffer);
         return;
     }
 
     //File needs re-opening
     if(fileNeedsReopen){
+        QElapsedTimer timer;
+        timer.start();
+        LoggerUtil::requestStoragePermissions();
+
         QDir dir(filename);
         if(dir.isAbsolute())
             qDebug() << "SimpleLogger::log(): Opening " + filename + " to log.";
@@ -106,20 +200,44 @@ void SimpleLogger::log(const QString& data){
         QDir::root().mkpath(QFileInfo(filename).absolutePath());
 
         file.setFileName(filename);
-        if(!file.open(QIODevice::WriteOnly | appendDisabled?QIODevice::WriteOnly:QIODevice::Append)){
+        if(!file.open(QIODevice::WriteOnly | (appendDisabled ? QIODevice::Truncate : QIODevice::Append) | QIODevice::Unbuffered)){
             qCritical() << "SimpleLogger::log(): Could not open file: " << file.errorString();
+
+            //Keep the line until the file can be opened, e.g once storage access is granted
+            lineBuffer.append('\n');
+            if(unopenedLines.size() + lineBuffer.size() <= maxUnopenedBytes)
+                unopenedLines.append(lineBuffer);
+            else
+                unopenedDropped++;
             return;
         }
-        else
-            writer.setDevice(&file);
 
         fileNeedsReopen = false;
+
+        if(!unopenedLines.isEmpty()){
+            if(file.write(unopenedLines) != unopenedLines.size())
+                qCritical() << "SimpleLogger::log(): Could not write to file: " << file.errorString();
+            unopenedLines.clear();
+        }
+        if(unopenedDropped > 0){
+            qWarning() << "SimpleLogger::log(): Dropped" << unopenedDropped << "lines logged before the file could be opened.";
+            unopenedDropped = 0;
+        }
+        qCDebug(loggerStartup) << "SimpleLogger::log(): Opened " + filename + " in" << timer.nsecsElapsed()/1000 << "us";
     }
 
     //Actual data logging
     if(file.isOpen()){
-        writer << linePrefix() << data << "\n";
-        writer.flush();
+        lineBuffer.append('\n');
+        if(file.write(lineBuffer) != lineBuffer.size())
+            qCritical() << "SimpleLogger::log(): Could not write to file: " << file.errorString();
+        if(level == Error && flushOnError){
+            #if defined(Q_OS_UNIX)
+                ::fsync(file.handle());
+            #elif defined(Q_OS_WIN)
+                ::_commit(file.handle());
+            #endif
+        }
     }
     else
         qCritical() << "SimpleLogger::log(): File is not open, valid filename must be provided beforehand.";
@@ -28,6 +28,47 @@
 #include <QQuickItem>
 #include <QString>
 #include <QFile>
+#include <QByteArray>
+#include <QAtomicInt>
+
+#include "CSVCodec.h"
+
+/**
+ * @brief Levels below this are compiled out of the QMLLOGGER_DEBUG() ... QMLLOGGER_ERROR() macros, 0 (debug) to 4 (none), default 0
+ */
+#ifndef QMLLOGGER_COMPILED_MIN_LEVEL
+    #define QMLLOGGER_COMPILED_MIN_LEVEL 0
+#endif
+
+/**
+ * @brief Logs data at the given level to the given SimpleLogger, data is not evaluated if the level is disabled
+ */
+#define QMLLOGGER_LOG_AT(logger, level, slot, data) \
+    do{ if((logger)->isLogging(QMLLogger::SimpleLogger::level)) (logger)->slot(data); } while(0)
+
+#if QMLLOGGER_COMPILED_MIN_LEVEL <= 0
+    #define QMLLOGGER_DEBUG(logger, data) QMLLOGGER_LOG_AT(logger, Debug, debug, data)
+#else
+    #define QMLLOGGER_DEBUG(logger, data) do{ } while(0)
+#endif
+
+#if QMLLOGGER_COMPILED_MIN_LEVEL <= 1
+    #define QMLLOGGER_INFO(logger, data) QMLLOGGER_LOG_AT(logger, Info, info, data)
+#else
+    #define QMLLOGGER_INFO(logger, data) do{ } while(0)
+#endif
+
+#if QMLLOGGER_COMPILED_MIN_LEVEL <= 2
+    #define QMLLOGGER_WARN(logger, data) QMLLOGGER_LOG_AT(logger, Warn, warn, data)
+#else
+    #define QMLLOGGER_WARN(logger, data) do{ } while(0)
+#endif
+
+#if QMLLOGGER_COMPILED_MIN_LEVEL <= 3
+    #define QMLLOGGER_ERROR(logger, data) QMLLOGGER_LOG_AT(logger, Error, error, data)
+#else
+    #define QMLLOGGER_ERROR(logger, data) do{ } while(0)
+#endif
 
 namespace QMLLogger{
 
@@ -48,6 +89,20 @@ namespace QMLLogger{
  * ```
  *     [timestamp in yyyy-MM-dd HH:mm:ss.zzz format if enabled] [unique device ID if enabled] data
  * ```
+ *
+ * The `debug()`, `info()`, `warn()` and `error()` slots log with a `[DEBUG] `, `[INFO] `, `[WARN] ` or `[ERROR] ` tag
+ * after the prefix, and return right away if their level is below `minLevel`. `log()` logs at the `Info` level without
+ * a tag. From C++, the `QMLLOGGER_DEBUG(logger, data)` ... `QMLLOGGER_ERROR(logger, data)` macros don't evaluate `data`
+ * if the level is disabled, and levels below `QMLLOGGER_COMPILED_MIN_LEVEL` are compiled out entirely.
+ *
+ * Line breaks in the logged data are written as `\n` and `\r` so that every entry stays on a single line.
+ *
+ * Lines logged while the file cannot be opened, e.g while storage access is being granted on first run, are kept in
+ * memory (up to 256 KiB) and written first once it opens; opening is retried with every line. The number of lines that
+ * did not fit is reported with a warning at that point.
+ *
+ * Lines are built in a buffer owned by the logger that is reused from line to line, so logging does not allocate once
+ * the buffer has grown to the longest line.
  */
 class SimpleLogger : public QQuickItem {
     /* *INDENT-OFF* */
@@ -72,8 +127,25 @@ class SimpleLogger : public QQuickItem {
     /** @brief Whether to append the log lines to the existing file or create a new file, default false */
     Q_PROPERTY(bool appendDisabled MEMBER appendDisabled)
 
+    /** @brief Lines below this level are discarded, default `SimpleLogger.Debug` */
+    Q_PROPERTY(Level minLevel WRITE setMinLevel READ getMinLevel)
+
+    /** @brief Whether `Error` level lines are flushed to the storage device immediately, default false */
+    Q_PROPERTY(bool flushOnError MEMBER flushOnError)
+
 public:
 
+    /**
+     * @brief Log levels, in increasing order of severity
+     */
+    enum Level {
+        Debug = 0,  ///< Debugging information
+        Info = 1,   ///< Normal operation
+        Warn = 2,   ///< Unexpected but recoverable
+        Error = 3   ///< Failure
+    };
+    Q_ENUM(Level)
+
     /** @cond DO_NOT_DOCUMENT */
 
     /**
@@ -102,8 +174,45 @@ public:
      */
     QString getFilename(){ return filename; }
 
+    /**
+     * @brief Sets the level below which lines are discarded
+     *
+     * @param minLevel The new minimum level
+     */
+    void setMinLevel(Level minLevel);
+
+    /**
+     * @brief Gets the level below which lines are discarded
+     *
+     * @return The minimum level
+     */
+    Level getMinLevel(){ return minLevel; }
+
     /** @endcond */
 
+    /**
+     * @brief Logs given UTF-8 data as one line to file, without going through QString
+     *
+     * @param data Data to log
+     * @param length Length of data in bytes, -1 if null terminated
+     */
+    void log(const char* data, int length = -1);
+
+    /**
+     * @brief Gets whether lines at the given level are currently logged
+     *
+     * @param level Level to check
+     * @return Whether this logger is enabled and level is at least minLevel, safe to call from any thread
+     */
+    bool isLogging(Level level) const { return level >= loggedLevel.load(); }
+
+    /**
+     * @brief Gets whether a SimpleLogger is writing a line in the current thread, i.e whether a message emitted now comes from a logger
+     *
+     * @return Whether a SimpleLogger is writing a line in the current thread
+     */
+    static bool isWritingInCurrentThread();
+
 signals:
 
     /** @cond DO_NOT_DOCUMENT */
@@ -124,6 +233,34 @@ public slots:
      */
     void log(const QString& data);
 
+    /**
+     * @brief Logs given data as one line with the `Debug` level
+     *
+     * @param data Data to log
+     */
+    void debug(const QString& data);
+
+    /**
+     * @brief Logs given data as one line with the `Info` level
+     *
+     * @param data Data to log
+     */
+    void info(const QString& data);
+
+    /**
+     * @brief Logs given data as one line with the `Warn` level
+     *
+     * @param data Data to log
+     */
+    void warn(const QString& data);
+
+    /**
+     * @brief Logs given data as one line with the `Error` level
+     *
+     * @param data Data to log
+     */
+    void error(const QString& data);
+
 private:
 
     bool logTime;           ///< Whether to include time when data is logged
@@ -134,18 +271,45 @@ private:
     bool appendDisabled;    ///< append option disabled
 
     QFile file;             ///< Log file
-    QTextStream writer;     ///< Log file writer
 
     bool toConsole;         ///< Log to console instead of file for debug purposes
+    Level minLevel;         ///< Lines below this level are discarded
+    QAtomicInt loggedLevel; ///< Lowest level that is logged, above Error if disabled; copy of minLevel and enabled for other threads
+    bool flushOnError;      ///< Whether to flush Error lines to the storage device immediately
+
+    QByteArray deviceId;    ///< Unique device ID prefix in UTF-8, empty until first needed
+    QByteArray unopenedLines; ///< Lines logged while the file could not be opened, written first once it is
+    int unopenedDropped;    ///< Number of lines that did not fit in unopenedLines
 
-    QString deviceId;       ///< Unique device ID
+    QByteArray lineBuffer;  ///< Reused buffer the current line is built in
+    TimestampFormatter timestampFormatter; ///< Formats and caches timestamps
 
     /**
-     * @brief Builds the log line info prefix
+     * @brief Starts a new line in the line buffer with the log line info prefix
+     */
+    void beginLine();
+
+    /**
+     * @brief Opens the file if needed and writes the line in the line buffer to it, or to the console
      *
-     * @return Log line info prefix
+     * @param level Level of the line
+     */
+    void commitLine(Level level = Info);
+
+    /**
+     * @brief Logs given data as one line with the given level and its tag
+     *
+     * @param level Level of the line
+     * @param data Data to log
+     */
+    void logTagged(Level level, const QString& data);
+
+private slots:
+
+    /**
+     * @brief Updates loggedLevel from minLevel and enabled
      */
-    QString linePrefix();
+    void updateLoggedLevel();
 
 };
 
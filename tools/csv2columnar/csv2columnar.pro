@@ -0,0 +1,23 @@
+TEMPLATE = app
+TARGET = csv2columnar
+
+QT = core concurrent
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+unix {
+    QMAKE_CXXFLAGS -= -O2
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+
+    QMAKE_CXXFLAGS += -O3
+    QMAKE_CXXFLAGS_RELEASE += -O3
+}
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+    ../../src/CSVCodec.h
+
+SOURCES += \
+    src/main.cpp \
+    ../../src/CSVCodec.cpp
@@ -0,0 +1,347 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <QtNumeric>
+
+#include <cstring>
+#include <limits>
+
+#include "CSVCodec.h"
+
+using namespace QMLLogger;
+
+namespace{
+
+enum ColumnType { Number, Timestamp, String };
+
+/**
+ * @brief Part of a log between two line boundaries, parsed independently of the others
+ */
+struct Chunk {
+    const char* begin;              ///< First byte of the chunk
+    const char* end;                ///< One past the last byte of the chunk
+    qint64 rows;                    ///< Number of parsed rows
+    qint64 invalid;                 ///< Number of fields that could not be parsed as their column type
+    QVector<QByteArray> data;       ///< Column data, per column
+    QVector<QVector<quint64>> ends; ///< End offsets of strings relative to the chunk, per column
+};
+
+/**
+ * @brief Trims the spaces and carriage return around a field
+ */
+inline void trim(const char*& begin, const char*& end){
+    while(begin < end && *begin == ' ')
+        begin++;
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\r'))
+        end--;
+}
+
+/**
+ * @brief Appends a field to the chunk's column data according to the column type
+ */
+inline void appendField(Chunk& chunk, QVector<ColumnType> const& types, int column, const char* begin, const char* end){
+    trim(begin, end);
+    switch(types[column]){
+        case Number: {
+            bool ok = begin < end;
+            double value = ok ? CSVCodec::parseDouble(begin, end, &ok) : 0;
+            if(!ok){
+                value = qQNaN();
+                chunk.invalid += begin < end;
+            }
+            quint64 bits;
+            memcpy(&bits, &value, sizeof(bits));
+            bits = qToLittleEndian(bits);
+            chunk.data[column].append((const char*)&bits, sizeof(bits));
+            break;
+        }
+        case Timestamp: {
+            qint64 value;
+            if(!CSVCodec::parseTimestamp(begin, end, &value)){
+                value = std::numeric_limits<qint64>::min();
+                chunk.invalid += begin < end;
+            }
+            value = qToLittleEndian(value);
+            chunk.data[column].append((const char*)&value, sizeof(value));
+            break;
+        }
+        case String:
+            CSVCodec::appendUnquoted(chunk.data[column], begin, end);
+            chunk.ends[column].append(chunk.data[column].size());
+            break;
+    }
+}
+
+/**
+ * @brief Parses all rows of a chunk into its column data
+ */
+void parseChunk(Chunk& chunk, QVector<ColumnType> const& types){
+    int columns = types.size();
+    qint64 estimatedRows = (chunk.end - chunk.begin)/(columns*4 + 1) + 1;
+    chunk.data.resize(columns);
+    chunk.ends.resize(columns);
+    for(int c = 0; c < columns; c++)
+        if(types[c] == String)
+            chunk.ends[c].reserve(int(qMin(estimatedRows, (qint64)1 << 24)));
+        else
+            chunk.data[c].reserve(int(qMin(estimatedRows*8, (qint64)1 << 28)));
+
+    const char* it = chunk.begin;
+    while(it < chunk.end){
+        bool lineEnded = false;
+        for(int c = 0; c < columns; c++){
+            if(lineEnded){
+                appendField(chunk, types, c, it, it); //Missing field
+                continue;
+            }
+            const char* fieldEnd = CSVCodec::findDelimiter(it, chunk.end);
+            appendField(chunk, types, c, it, fieldEnd);
+            lineEnded = fieldEnd == chunk.end || *fieldEnd == '\n';
+            it = fieldEnd < chunk.end ? fieldEnd + 1 : chunk.end;
+        }
+
+        //Extra fields beyond the header
+        if(!lineEnded){
+            chunk.invalid++;
+            const char* newline = CSVCodec::findRowEnd(it, chunk.end);
+            it = newline < chunk.end ? newline + 1 : chunk.end;
+        }
+        chunk.rows++;
+    }
+}
+
+/**
+ * @brief Infers column types from the first rows
+ */
+QVector<ColumnType> inferTypes(QList<QByteArray> const& header, const char* begin, const char* end, int sampleRows){
+    QVector<ColumnType> types(header.size(), Timestamp);
+    for(int c = 0; c < header.size(); c++)
+        if(header[c].trimmed() != "timestamp")
+            types[c] = Number;
+
+    const char* it = begin;
+    for(int row = 0; row < sampleRows && it < end; row++){
+        const char* lineEnd = CSVCodec::findRowEnd(it, end);
+        for(int c = 0; c < types.size(); c++){
+            const char* fieldEnd;
+            const char* field = CSVCodec::findField(it, lineEnd, c, &fieldEnd);
+            if(!field)
+                break;
+            trim(field, fieldEnd);
+            if(field == fieldEnd)
+                continue;
+            qint64 msecs;
+            bool ok = true;
+            if(types[c] == Timestamp)
+                ok = CSVCodec::parseTimestamp(field, fieldEnd, &msecs);
+            else if(types[c] == Number)
+                CSVCodec::parseDouble(field, fieldEnd, &ok);
+            if(!ok)
+                types[c] = String;
+        }
+        it = lineEnd + 1;
+    }
+    return types;
+}
+
+/**
+ * @brief Writes all given bytes to an output file, reporting failures
+ *
+ * @return Whether all bytes were written
+ */
+bool writeAll(QFile* file, QByteArray const& data, QTextStream& err){
+    if(file->write(data) == data.size())
+        return true;
+    err << file->fileName() << ": " << file->errorString() << "\n";
+    return false;
+}
+
+/**
+ * @brief Opens an output file for writing, reporting failures
+ *
+ * @return Whether the file could be opened
+ */
+bool openOutput(QFile* file, QTextStream& err){
+    if(file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return true;
+    err << file->fileName() << ": " << file->errorString() << "\n";
+    return false;
+}
+
+/**
+ * @brief Converts one log to a directory of column files
+ *
+ * @return Number of bytes converted, -1 on error
+ */
+qint64 convert(QString const& inputFilename, QString const& outputDir, int threads, qint64 chunkSize, QTextStream& err){
+    QFile input(inputFilename);
+    if(!input.open(QIODevice::ReadOnly)){
+        err << inputFilename << ": " << input.errorString() << "\n";
+        return -1;
+    }
+    qint64 size = input.size();
+    const char* data = size > 0 ? (const char*)input.map(0, size) : nullptr;
+    if(!data){
+        err << inputFilename << ": Could not map: " << input.errorString() << "\n";
+        return -1;
+    }
+    const char* end = data + size;
+    const char* headerEnd = (const char*)memchr(data, '\n', size);
+    if(!headerEnd){
+        err << inputFilename << ": No header" << "\n";
+        return -1;
+    }
+
+    QList<QByteArray> header = QByteArray(data, int(headerEnd - data)).split(',');
+    QVector<ColumnType> types = inferTypes(header, headerEnd + 1, end, 1000);
+
+    //Open column files and write schema
+    QDir().mkpath(outputDir);
+    QFile schema(outputDir + "/schema.csv");
+    if(!openOutput(&schema, err))
+        return -1;
+    bool ok = writeAll(&schema, "name, type, file\n", err);
+    QVector<QFile*> dataFiles;
+    QVector<QFile*> offsetFiles;
+    QVector<quint64> stringBases(types.size(), 0);
+    static const char* const typeNames[] = { "f64", "i64", "str" };
+    for(int c = 0; c < types.size() && ok; c++){
+        QString base = QString("col%1").arg(c, 3, 10, QChar('0'));
+        QString extension = typeNames[types[c]];
+        dataFiles << new QFile(outputDir + "/" + base + "." + extension);
+        ok = openOutput(dataFiles.last(), err);
+        offsetFiles << nullptr;
+        if(ok && types[c] == String){
+            offsetFiles.last() = new QFile(outputDir + "/" + base + ".off");
+            quint64 zero = 0;
+            ok = openOutput(offsetFiles.last(), err) && writeAll(offsetFiles.last(), QByteArray::fromRawData((const char*)&zero, sizeof(zero)), err);
+        }
+        QByteArray line = header[c].trimmed() + ", " + extension.toLatin1() + ", " + base.toLatin1() + "." + extension.toLatin1() + "\n";
+        ok = ok && writeAll(&schema, line, err);
+    }
+    if(!ok){
+        qDeleteAll(dataFiles);
+        qDeleteAll(offsetFiles);
+        return -1;
+    }
+
+    //Split at row boundaries; quotes are rare, so counting them to tell whether a newline is quoted is cheap
+    QVector<Chunk> chunks;
+    const char* chunkBegin = headerEnd + 1;
+    while(chunkBegin < end){
+        const char* chunkEnd = chunkBegin + qMin(chunkSize, (qint64)(end - chunkBegin));
+        if(chunkEnd < end){
+            bool quoted = false;
+            for(const char* quote = chunkBegin; (quote = (const char*)memchr(quote, '"', chunkEnd - quote)); quote++)
+                quoted = !quoted;
+            if(quoted){
+                const char* closing = (const char*)memchr(chunkEnd, '"', end - chunkEnd);
+                chunkEnd = closing ? closing + 1 : end;
+            }
+            const char* newline = CSVCodec::findRowEnd(chunkEnd, end);
+            chunkEnd = newline < end ? newline + 1 : end;
+        }
+        Chunk chunk;
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunk.rows = 0;
+        chunk.invalid = 0;
+        chunks << chunk;
+        chunkBegin = chunkEnd;
+    }
+
+    //Parse in waves of one chunk per thread to bound memory, write in order
+    qint64 rows = 0;
+    qint64 invalid = 0;
+    for(int wave = 0; wave < chunks.size() && ok; wave += threads){
+        QVector<Chunk> current = chunks.mid(wave, threads);
+        QtConcurrent::blockingMap(current, [&types](Chunk& chunk){ parseChunk(chunk, types); });
+        for(Chunk const& chunk : current){
+            for(int c = 0; c < types.size() && ok; c++){
+                ok = writeAll(dataFiles[c], chunk.data[c], err);
+                if(ok && types[c] == String){
+                    QVector<quint64> ends = chunk.ends[c];
+                    for(quint64& e : ends)
+                        e = qToLittleEndian(e + stringBases[c]);
+                    ok = writeAll(offsetFiles[c], QByteArray::fromRawData((const char*)ends.constData(), ends.size()*(int)sizeof(quint64)), err);
+                    stringBases[c] += chunk.data[c].size();
+                }
+            }
+            rows += chunk.rows;
+            invalid += chunk.invalid;
+        }
+    }
+
+    //Buffered writes only fail for good when flushed, e.g when the storage is full
+    QVector<QFile*> outputs = dataFiles + offsetFiles;
+    outputs << &schema;
+    for(QFile* file : outputs)
+        if(ok && file && !file->flush()){
+            err << file->fileName() << ": " << file->errorString() << "\n";
+            ok = false;
+        }
+    qDeleteAll(dataFiles);
+    qDeleteAll(offsetFiles);
+    if(!ok){
+        err << inputFilename << ": Conversion failed, column files in " << outputDir << " are incomplete" << "\n";
+        return -1;
+    }
+    if(invalid > 0)
+        err << inputFilename << ": " << invalid << " fields could not be parsed as their column type" << "\n";
+    err << inputFilename << ": " << rows << " rows, " << types.size() << " columns" << "\n";
+    return size;
+}
+
+}
+
+int main(int argc, char *argv[]){
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts CSVLogger logs to directories of binary column files, in parallel.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logs", "CSV logs to convert", "logs...");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write column directories under <dir>, default current directory.", "dir", ".");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Parse with <n> threads, default all cores.", "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption chunkOption(QStringList() << "c" << "chunk-size", "Split logs into chunks of <MB> megabytes, default 32.", "MB", "32");
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(chunkOption);
+    parser.process(app);
+
+    QStringList inputs = parser.positionalArguments();
+    if(inputs.isEmpty())
+        parser.showHelp(1);
+    int threads = qMax(1, parser.value(threadsOption).toInt());
+    qint64 chunkSize = qMax((qint64)1, parser.value(chunkOption).toLongLong()) << 20;
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+    QTextStream err(stderr);
+    QElapsedTimer timer;
+    timer.start();
+    qint64 totalBytes = 0;
+    int failed = 0;
+    for(QString const& input : inputs){
+        QElapsedTimer fileTimer;
+        fileTimer.start();
+        qint64 bytes = convert(input, parser.value(outputOption) + "/" + QFileInfo(input).completeBaseName(), threads, chunkSize, err);
+        if(bytes < 0){
+            failed++;
+            continue;
+        }
+        totalBytes += bytes;
+        err << input << ": " << QString::number(double(bytes)/qMax((qint64)1, fileTimer.nsecsElapsed()), 'f', 3) << " GB/s" << "\n";
+        err.flush();
+    }
+    err << "Total: " << QString::number(totalBytes/1e9, 'f', 3) << " GB in " << QString::number(timer.nsecsElapsed()/1e9, 'f', 3) << " s, "
+        << QString::number(double(totalBytes)/qMax((qint64)1, timer.nsecsElapsed()), 'f', 3) << " GB/s with " << threads << " threads" << "\n";
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+TEMPLATE = app
+TARGET = log-extract
+
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+    ../../src/CSVLogIndex.h \
+    ../../src/CSVCodec.h
+
+SOURCES += \
+    src/main.cpp \
+    ../../src/CSVLogIndex.cpp \
+    ../../src/CSVCodec.cpp
@@ -0,0 +1,58 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+
+#include "CSVLogIndex.h"
+
+using namespace QMLLogger;
+
+int main(int argc, char *argv[]){
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Extracts the rows between two times from a CSVLogger log using its time index.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("log", "CSV log to extract from");
+    parser.addPositionalArgument("from", "Beginning of the time range, yyyy-MM-dd HH:mm:ss[.zzz] in local time");
+    parser.addPositionalArgument("to", "End of the time range, yyyy-MM-dd HH:mm:ss[.zzz] in local time");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write to <file> instead of stdout.", "file");
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QStringList args = parser.positionalArguments();
+    if(args.size() != 3)
+        parser.showHelp(1);
+
+    QDateTime from = QDateTime::fromString(args[1], "yyyy-MM-dd HH:mm:ss.zzz");
+    if(!from.isValid())
+        from = QDateTime::fromString(args[1], "yyyy-MM-dd HH:mm:ss");
+    QDateTime to = QDateTime::fromString(args[2], "yyyy-MM-dd HH:mm:ss.zzz");
+    if(!to.isValid())
+        to = QDateTime::fromString(args[2], "yyyy-MM-dd HH:mm:ss").addMSecs(999);
+    if(!from.isValid() || !to.isValid()){
+        QTextStream(stderr) << "Invalid time range." << "\n";
+        return 1;
+    }
+
+    QFile out;
+    bool opened;
+    if(parser.isSet(outputOption)){
+        out.setFileName(parser.value(outputOption));
+        opened = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    else
+        opened = out.open(stdout, QIODevice::WriteOnly);
+    if(!opened){
+        QTextStream(stderr) << "Could not open output: " << out.errorString() << "\n";
+        return 1;
+    }
+
+    qint64 rows = CSVLogIndex::extractRange(args[0], from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch(), &out);
+    out.close();
+    if(rows < 0)
+        return 1;
+    QTextStream(stderr) << rows << " rows extracted." << "\n";
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = log-merge
+
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+    ../../src/CSVCodec.h
+
+SOURCES += \
+    src/main.cpp \
+    ../../src/CSVCodec.cpp
@@ -0,0 +1,188 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QVector>
+
+#include <queue>
+#include <vector>
+
+#include "CSVCodec.h"
+
+using namespace QMLLogger;
+
+namespace{
+
+/**
+ * @brief One of the logs being merged, read one line at a time
+ */
+struct Source {
+    QFile file;                 ///< Log file
+    QList<QByteArray> columns;  ///< Header fields excluding the timestamp
+    int firstOutputColumn;      ///< Index of the first column of this log in the output, excluding the timestamp
+    QByteArray line;            ///< Current line, without the newline
+    qint64 key;                 ///< Current line's timestamp if numeric
+    QByteArray textKey;         ///< Current line's timestamp if text
+
+    /**
+     * @brief Reads the next non-empty row
+     *
+     * @param numeric Whether the timestamps are numeric
+     * @return Whether there was a line
+     */
+    bool next(bool numeric){
+        do{
+            if(file.atEnd())
+                return false;
+            line = file.readLine();
+
+            //A quoted field may span several lines
+            while(!file.atEnd() && CSVCodec::findRowEnd(line.constData(), line.constData() + line.size()) == line.constData() + line.size())
+                line += file.readLine();
+            while(line.endsWith('\n') || line.endsWith('\r'))
+                line.chop(1);
+        } while(line.isEmpty());
+        const char* keyEnd;
+        const char* keyBegin = CSVCodec::findField(line.constData(), line.constData() + line.size(), 0, &keyEnd);
+        if(numeric){
+            bool ok;
+            key = QByteArray(keyBegin, int(keyEnd - keyBegin)).trimmed().toLongLong(&ok);
+            if(!ok)
+                key = 0;
+        }
+        else
+            textKey = QByteArray(keyBegin, int(keyEnd - keyBegin));
+        return true;
+    }
+};
+
+}
+
+int main(int argc, char *argv[]){
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Merges CSVLogger logs by time into one log with the columns of all of them.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logs", "CSV logs to merge, each sorted by its first column (sessionNanos or timestamp)", "logs...");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write to <file> instead of stdout.", "file");
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QStringList inputs = parser.positionalArguments();
+    if(inputs.isEmpty())
+        parser.showHelp(1);
+    QTextStream err(stderr);
+
+    //Open all logs and build the union header, each column prefixed with its log's name
+    std::vector<Source*> sources;
+    QByteArray timeColumn;
+    QByteArray outputHeader;
+    int outputColumns = 0;
+    for(QString const& input : inputs){
+        Source* source = new Source();
+        sources.push_back(source);
+        source->file.setFileName(input);
+        if(!source->file.open(QIODevice::ReadOnly)){
+            err << input << ": " << source->file.errorString() << "\n";
+            return 1;
+        }
+        QList<QByteArray> header = source->file.readLine().trimmed().split(',');
+        for(QByteArray& field : header)
+            field = field.trimmed();
+        if(timeColumn.isEmpty()){
+            timeColumn = header.first();
+            outputHeader = timeColumn;
+        }
+        else if(header.first() != timeColumn){
+            err << input << ": First column is " << header.first() << " instead of " << timeColumn << "\n";
+            return 1;
+        }
+        QByteArray prefix = QFileInfo(input).completeBaseName().toUtf8() + ".";
+        source->columns = header.mid(1);
+        source->firstOutputColumn = outputColumns;
+        for(QByteArray const& column : source->columns)
+            outputHeader += ", " + prefix + column;
+        outputColumns += source->columns.size();
+    }
+    bool numeric = timeColumn == "sessionNanos";
+
+    QFile out;
+    bool opened;
+    if(parser.isSet(outputOption)){
+        out.setFileName(parser.value(outputOption));
+        opened = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    else
+        opened = out.open(stdout, QIODevice::WriteOnly);
+    if(!opened){
+        err << "Could not open output: " << out.errorString() << "\n";
+        return 1;
+    }
+    out.write(outputHeader + "\n");
+
+    //K-way merge on a min-heap of the current line of each log, ties broken by log order
+    auto later = [&sources, numeric](int a, int b){
+        Source* sa = sources[a];
+        Source* sb = sources[b];
+        if(numeric ? sa->key != sb->key : sa->textKey != sb->textKey)
+            return numeric ? sa->key > sb->key : sa->textKey > sb->textKey;
+        return a > b;
+    };
+    std::priority_queue<int, std::vector<int>, decltype(later)> heap(later);
+    for(int i = 0; i < (int)sources.size(); i++)
+        if(sources[i]->next(numeric))
+            heap.push(i);
+
+    qint64 rows = 0;
+    QByteArray row;
+    bool warnedUnsorted = false;
+    while(!heap.empty()){
+        int i = heap.top();
+        heap.pop();
+        Source* source = sources[i];
+
+        //Timestamp, empty fields before this log's columns, this log's fields, empty fields after
+        const char* lineEnd = source->line.constData() + source->line.size();
+        const char* timeEnd;
+        CSVCodec::findField(source->line.constData(), lineEnd, 0, &timeEnd);
+        row.resize(0);
+        row.append(source->line.constData(), int(timeEnd - source->line.constData()));
+        for(int c = 0; c < source->firstOutputColumn; c++)
+            row.append(", ", 2);
+        if(timeEnd < lineEnd)
+            row.append(timeEnd, int(lineEnd - timeEnd));
+        else
+            for(int c = 0; c < source->columns.size(); c++)
+                row.append(", ", 2);
+        for(int c = source->firstOutputColumn + source->columns.size(); c < outputColumns; c++)
+            row.append(", ", 2);
+        row.append('\n');
+        out.write(row);
+        rows++;
+
+        //Merging assumes every log is sorted by time; session times of another session restart at 0
+        qint64 key = source->key;
+        QByteArray textKey = source->textKey;
+        if(source->next(numeric)){
+            if(numeric && source->key < key){
+                err << source->file.fileName() << ": sessionNanos goes back from " << key << " to " << source->key
+                    << ", the log holds several sessions; split it into one log per session first" << "\n";
+                return 1;
+            }
+            if(!numeric && source->textKey < textKey && !warnedUnsorted){
+                err << source->file.fileName() << ": timestamp goes back from " << textKey << " to " << source->textKey
+                    << ", e.g because the wall clock was adjusted; rows around it are merged out of order" << "\n";
+                err.flush();
+                warnedUnsorted = true;
+            }
+            heap.push(i);
+        }
+    }
+
+    out.close();
+    qDeleteAll(sources);
+    err << rows << " rows merged from " << inputs.size() << " logs." << "\n";
+    return 0;
+}
@@ -0,0 +1,395 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QFile>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <functional>
+
+#include "CSVCodec.h"
+#include "CSVLogger.h"
+#include "SimpleLogger.h"
+
+using namespace QMLLogger;
+
+namespace{
+
+std::atomic<bool> countAllocations(false);      ///< Whether allocations are being counted
+std::atomic<quint64> allocations(0);            ///< Number of allocations counted so far
+
+}
+
+#if defined(__GLIBC__)
+
+//Interpose the C allocator, which both operator new and Qt's containers end up in
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size){
+    if(countAllocations.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size){
+    if(countAllocations.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size){
+    if(countAllocations.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+}
+
+    #define ALLOCATION_COUNTING_SUPPORTED true
+#else
+    #define ALLOCATION_COUNTING_SUPPORTED false
+#endif
+
+namespace{
+
+/**
+ * @brief Runs a benchmark case and prints its time and allocations per row
+ */
+void run(QTextStream& out, QString const& name, int rows, std::function<void()> const& logRow){
+    for(int i = 0; i < 1000; i++) //Warm up buffers and caches
+        logRow();
+
+    allocations = 0;
+    countAllocations = true;
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < rows; i++)
+        logRow();
+    qint64 elapsed = timer.nsecsElapsed();
+    countAllocations = false;
+
+    out << name.leftJustified(32)
+        << QString::number(double(elapsed)/rows, 'f', 1) << " ns/row, ";
+    if(ALLOCATION_COUNTING_SUPPORTED)
+        out << QString::number(double(allocations.load())/rows, 'f', 3) << " allocations/row";
+    else
+        out << "allocations/row not supported on this platform";
+    out << "\n";
+    out.flush();
+}
+
+/**
+ * @brief Formats a number with printf like the reference does, with `.` as decimal separator regardless of the locale
+ */
+QByteArray printfDouble(double value, int precision){
+    char buffer[352];
+    int length = qsnprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+    QByteArray result(buffer, qBound(0, length, (int)sizeof(buffer) - 1));
+    result.replace(',', '.');
+    return result;
+}
+
+/**
+ * @brief Appends a field quoted as per RFC 4180 if needed, scanning it one byte at a time, like CSVCodec::quoteField does 16 at a time
+ */
+void appendQuotedScalar(QByteArray& out, QByteArray const& field){
+    bool special = false;
+    for(char c : field)
+        if(c == ',' || c == '"' || c == '\r' || c == '\n'){
+            special = true;
+            break;
+        }
+    if(!special){
+        out.append(field);
+        return;
+    }
+    out.append('"');
+    for(char c : field){
+        out.append(c);
+        if(c == '"')
+            out.append('"');
+    }
+    out.append('"');
+}
+
+/**
+ * @brief Compares CSVCodec::appendDouble against printf on edge cases and random numbers, prints the first mismatches
+ *
+ * @return Number of mismatches
+ */
+int verifyNumbers(QTextStream& out, int count){
+    QVector<double> values;
+    values << 0.0 << -0.0 << 0.5 << -0.5 << 1.5 << 2.5 << 0.125 << 0.375 << 1.005 << 2.675 << 9.995 << 0.045
+           << 1e-7 << -1e-7 << 0.004999999999999999 << 1099511627775.5 << 1099511627776.0 << 1e15 << 1e16
+           << 4503599627370495.5 << 9007199254740993.0 << 1e300 << -1e300
+           << std::numeric_limits<double>::max() << std::numeric_limits<double>::min()
+           << std::numeric_limits<double>::denorm_min() << std::numeric_limits<double>::epsilon()
+           << std::numeric_limits<double>::infinity() << -std::numeric_limits<double>::infinity()
+           << std::numeric_limits<double>::quiet_NaN();
+
+    //Uniform mantissas over the magnitudes of the fast path and beyond, values next to rounding ties, raw bit patterns
+    std::mt19937_64 random(20261019);
+    std::uniform_real_distribution<double> mantissa(-1.0, 1.0);
+    std::uniform_int_distribution<int> exponent(-12, 18);
+    std::uniform_int_distribution<int> tiePrecision(0, 15);
+    std::uniform_int_distribution<qint64> tieDigits(0, 99999999);
+    for(int i = 0; i < count; i++){
+        values << mantissa(random)*std::pow(10.0, exponent(random));
+        int p = tiePrecision(random);
+        double tie = (tieDigits(random)*10 + 5)/std::pow(10.0, p + 1);
+        values << tie << std::nextafter(tie, 0.0) << std::nextafter(tie, 1e300);
+        quint64 bits = random();
+        double raw;
+        std::memcpy(&raw, &bits, sizeof(raw));
+        values << raw;
+    }
+
+    int precisions[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 20, 30};
+    qint64 checked = 0;
+    int mismatches = 0;
+    QByteArray buffer;
+    for(double value : values)
+        for(int precision : precisions){
+            buffer.resize(0);
+            CSVCodec::appendDouble(buffer, value, precision);
+            QByteArray expected = printfDouble(value, precision);
+            checked++;
+            if(buffer != expected && ++mismatches <= 20)
+                out << "Mismatch for " << QString::number(value, 'g', 17) << " with precision " << precision
+                    << ": " << buffer << " instead of " << expected << "\n";
+        }
+    out << "Checked " << checked << " numbers, " << mismatches << " mismatches" << "\n";
+    out.flush();
+    return mismatches;
+}
+
+/**
+ * @brief Compares CSVCodec::quoteField and CSVCodec::findRowEnd against byte by byte references on random fields
+ *
+ * @return Number of mismatches
+ */
+int verifyFields(QTextStream& out, int count){
+    //Mostly plain characters so that runs longer than the 16 bytes scanned at a time are common
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyz \xC3\xA9";
+    const char specials[] = ",\"\r\n";
+    std::mt19937_64 random(20261019);
+    std::uniform_int_distribution<int> length(0, 80);
+    std::uniform_int_distribution<int> offset(0, 15);
+    std::uniform_int_distribution<int> pick(0, 99);
+
+    qint64 checked = 0;
+    int mismatches = 0;
+    QByteArray field;
+    QByteArray quoted;
+    QByteArray expected;
+    for(int i = 0; i < count; i++){
+        //Fields without special characters, with a few and with many
+        int specialPercent = i%3 == 0 ? 0 : (i%3 == 1 ? 2 : 20);
+        field.resize(0);
+        for(int n = length(random); n > 0; n--){
+            int p = pick(random);
+            field.append(p < specialPercent ? specials[p%4] : alphabet[p%(sizeof(alphabet) - 1)]);
+        }
+
+        //Quote after a prefix of arbitrary length, so that the field begins at every alignment
+        int from = offset(random);
+        quoted = QByteArray(from, 'x') + field;
+        CSVCodec::quoteField(quoted, from);
+        expected = QByteArray(from, 'x');
+        appendQuotedScalar(expected, field);
+        checked++;
+        if(quoted != expected && ++mismatches <= 20)
+            out << "Quoting mismatch for " << field.toPercentEncoding() << ": " << quoted.mid(from).toPercentEncoding()
+                << " instead of " << expected.mid(from).toPercentEncoding() << "\n";
+
+        //The row ends at the newline after the field, not at one inside it or in the next row
+        int rowEnd = expected.size();
+        expected.append("\nnext, \"row\n\"\n");
+        const char* found = CSVCodec::findRowEnd(expected.constData(), expected.constData() + expected.size());
+        checked++;
+        if(found - expected.constData() != rowEnd && ++mismatches <= 20)
+            out << "Row end mismatch in " << expected.toPercentEncoding() << ": " << (found - expected.constData())
+                << " instead of " << rowEnd << "\n";
+    }
+    out << "Checked " << checked << " fields and rows, " << mismatches << " mismatches" << "\n";
+    out.flush();
+    return mismatches;
+}
+
+}
+
+int main(int argc, char *argv[]){
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures time and heap allocations per row of the loggers.");
+    parser.addHelpOption();
+    QCommandLineOption rowsOption(QStringList() << "n" << "rows", "Log <n> rows per case, default 100000.", "n", "100000");
+    QCommandLineOption columnsOption(QStringList() << "c" << "columns", "Log <n> columns per row, default 8.", "n", "8");
+    QCommandLineOption verifyOption("verify", "Instead of benchmarking, check that numbers are formatted exactly like printf on <n> random numbers of each kind.");
+    parser.addOption(rowsOption);
+    parser.addOption(columnsOption);
+    parser.addOption(verifyOption);
+    parser.process(app);
+
+    int rows = qMax(1, parser.value(rowsOption).toInt());
+    int columns = qMax(1, parser.value(columnsOption).toInt());
+
+    QTextStream out(stdout);
+    if(parser.isSet(verifyOption))
+        return verifyNumbers(out, rows) + verifyFields(out, rows) == 0 ? 0 : -1;
+
+    QTemporaryDir dir;
+
+    QList<QString> header;
+    QVariantList numbers;
+    QVariantList strings;
+    QVariantList sentences;
+    QVariantList quotedSentences;
+    QVector<double> values;
+    for(int i = 0; i < columns; i++){
+        header << "column" + QString::number(i);
+        numbers << 1234.5678*(i + 1);
+        strings << "value" + QString::number(i);
+        sentences << "The quick brown fox jumps over the lazy dog number " + QString::number(i);
+        quotedSentences << "The quick, brown \"fox\" jumps over the lazy dog number " + QString::number(i);
+        values << 1234.5678*(i + 1);
+    }
+
+    CSVLogger csvLogger;
+    csvLogger.setHeader(header);
+
+    csvLogger.setFilename(dir.path() + "/numbers.csv");
+    run(out, "CSVLogger QVariantList numbers", rows, [&](){ csvLogger.log(numbers); });
+
+    csvLogger.setFilename(dir.path() + "/strings.csv");
+    run(out, "CSVLogger QVariantList strings", rows, [&](){ csvLogger.log(strings); });
+
+    csvLogger.setFilename(dir.path() + "/sentences.csv");
+    run(out, "CSVLogger QVariantList clean sentences", rows, [&](){ csvLogger.log(sentences); });
+
+    csvLogger.setFilename(dir.path() + "/quoted.csv");
+    run(out, "CSVLogger QVariantList quoted sentences", rows, [&](){ csvLogger.log(quotedSentences); });
+
+    csvLogger.setFilename(dir.path() + "/doubles.csv");
+    run(out, "CSVLogger const double*", rows, [&](){ csvLogger.log(values.constData(), values.size()); });
+
+    CSVLogger mixedLogger;
+    QList<int> columnPrecision;
+    QList<qreal> columnScale;
+    for(int i = 0; i < columns; i++){
+        columnPrecision << (i%2 == 0 ? 6 : 1);
+        columnScale << (i%2 == 0 ? 1 : 100);
+    }
+    mixedLogger.setHeader(header);
+    mixedLogger.setColumnPrecision(columnPrecision);
+    mixedLogger.setColumnScale(columnScale);
+    mixedLogger.setFilename(dir.path() + "/mixed.csv");
+    run(out, "CSVLogger const double* per-column precision", rows, [&](){ mixedLogger.log(values.constData(), values.size()); });
+
+    //Reference paths: the same rows without timestamp, formatted with printf and with QString::number, written the same way
+    CSVLogger plainLogger;
+    plainLogger.setHeader(header);
+    plainLogger.setLogTime(false);
+    plainLogger.setFilename(dir.path() + "/plain.csv");
+    int precision = plainLogger.property("precision").toInt();
+    run(out, "CSVLogger const double* without time", rows, [&](){ plainLogger.log(values.constData(), values.size()); });
+
+    QFile referenceFile(dir.path() + "/reference-printf.csv");
+    referenceFile.open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+    QByteArray referenceLine;
+    run(out, "Reference qsnprintf", rows, [&](){
+        char buffer[352];
+        referenceLine.resize(0);
+        for(int i = 0; i < values.size(); i++){
+            if(i > 0)
+                referenceLine.append(", ", 2);
+            referenceLine.append(buffer, qsnprintf(buffer, sizeof(buffer), "%.*f", precision, values[i]));
+        }
+        referenceLine.append('\n');
+        referenceFile.write(referenceLine);
+    });
+    referenceFile.close();
+
+    referenceFile.setFileName(dir.path() + "/reference-qstring.csv");
+    referenceFile.open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+    run(out, "Reference QString::number", rows, [&](){
+        QString line;
+        for(int i = 0; i < values.size(); i++){
+            if(i > 0)
+                line += ", ";
+            line += QString::number(values[i], 'f', precision);
+        }
+        line += '\n';
+        referenceFile.write(line.toUtf8());
+    });
+    referenceFile.close();
+
+    //Reference paths for strings, encoded to UTF-8 beforehand: copied verbatim without looking for characters that
+    //require quoting, as before quoting was introduced, and scanned for them one byte at a time
+    plainLogger.setFilename(dir.path() + "/plain-sentences.csv");
+    run(out, "CSVLogger clean sentences without time", rows, [&](){ plainLogger.log(sentences); });
+    plainLogger.setFilename(dir.path() + "/plain-quoted.csv");
+    run(out, "CSVLogger quoted sentences without time", rows, [&](){ plainLogger.log(quotedSentences); });
+
+    QVector<QByteArray> sentenceBytes;
+    QVector<QByteArray> quotedSentenceBytes;
+    for(int i = 0; i < columns; i++){
+        sentenceBytes << sentences[i].toString().toUtf8();
+        quotedSentenceBytes << quotedSentences[i].toString().toUtf8();
+    }
+    auto runStringReference = [&](QString const& name, QVector<QByteArray> const& fields, bool scan){
+        referenceFile.setFileName(dir.path() + "/reference-strings.csv");
+        referenceFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered);
+        run(out, name, rows, [&](){
+            referenceLine.resize(0);
+            for(int i = 0; i < fields.size(); i++){
+                if(i > 0)
+                    referenceLine.append(", ", 2);
+                if(scan)
+                    appendQuotedScalar(referenceLine, fields[i]);
+                else
+                    referenceLine.append(fields[i]);
+            }
+            referenceLine.append('\n');
+            referenceFile.write(referenceLine);
+        });
+        referenceFile.close();
+    };
+    runStringReference("Reference verbatim clean sentences", sentenceBytes, false);
+    runStringReference("Reference scalar scan clean sentences", sentenceBytes, true);
+    runStringReference("Reference scalar scan quoted sentences", quotedSentenceBytes, true);
+
+    //Caller side cost only, formatting and writing happen on the writer thread
+    CSVLogger asyncLogger;
+    asyncLogger.setHeader(header);
+    asyncLogger.setAsynchronous(true);
+    asyncLogger.setProperty("memoryBudget", 256 << 20); //Don't drop rows while the writer thread catches up
+    asyncLogger.setFilename(dir.path() + "/async-numbers.csv");
+    run(out, "CSVLogger asynchronous QVariantList numbers", rows, [&](){ asyncLogger.log(numbers); });
+    asyncLogger.setFilename(dir.path() + "/async-strings.csv");
+    run(out, "CSVLogger asynchronous QVariantList strings", rows, [&](){ asyncLogger.log(strings); });
+    asyncLogger.setFilename(dir.path() + "/async-doubles.csv");
+    run(out, "CSVLogger asynchronous const double*", rows, [&](){ asyncLogger.log(values.constData(), values.size()); });
+    asyncLogger.close();
+
+    SimpleLogger simpleLogger;
+    simpleLogger.setFilename(dir.path() + "/simple.log");
+    QString line = "The quick brown fox jumps over the lazy dog";
+    run(out, "SimpleLogger QString", rows, [&](){ simpleLogger.log(line); });
+    run(out, "SimpleLogger const char*", rows, [&](){ simpleLogger.log("The quick brown fox jumps over the lazy dog"); });
+
+    return 0;
+}
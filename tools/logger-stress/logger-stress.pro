@@ -0,0 +1,33 @@
+TEMPLATE = app
+TARGET = logger-stress
+
+QT = core gui quick bluetooth network
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+unix {
+    QMAKE_CXXFLAGS -= -O2
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+
+    QMAKE_CXXFLAGS += -O3
+    QMAKE_CXXFLAGS_RELEASE += -O3
+}
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+    ../../src/LoggerUtil.h \
+    ../../src/SimpleLogger.h \
+    ../../src/CSVLogger.h \
+    ../../src/LogSession.h \
+    ../../src/CSVLogIndex.h \
+    ../../src/CSVCodec.h
+
+SOURCES += \
+    src/main.cpp \
+    ../../src/LoggerUtil.cpp \
+    ../../src/SimpleLogger.cpp \
+    ../../src/CSVLogger.cpp \
+    ../../src/LogSession.cpp \
+    ../../src/CSVLogIndex.cpp \
+    ../../src/CSVCodec.cpp
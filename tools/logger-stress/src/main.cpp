@@ -0,0 +1,615 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+    #include <fcntl.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
+#endif
+
+//USDT probes that cost a nop unless a tracer attaches to them, e.g `perf probe sdt_qml_logger_stress:frame_begin`
+#if defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+        #include <sys/sdt.h>
+        #define STRESS_PROBE(name, a, b) DTRACE_PROBE2(qml_logger_stress, name, a, b)
+    #endif
+#endif
+#ifndef STRESS_PROBE
+    #define STRESS_PROBE(name, a, b)
+#endif
+
+#include "CSVLogger.h"
+#include "SimpleLogger.h"
+
+using namespace QMLLogger;
+
+namespace{
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const auto skipEmptyParts = Qt::SkipEmptyParts;        ///< Drops empty entries when splitting lists
+#else
+    const auto skipEmptyParts = QString::SkipEmptyParts;   ///< Drops empty entries when splitting lists
+#endif
+
+/**
+ * @brief One point of the sweep
+ */
+struct Config {
+    QString logger;     ///< csv or simple
+    QString policy;     ///< row, frame, async or async-frame
+    QString target;     ///< directory for one file per instance, file for one file shared by all instances
+    int instances;      ///< Number of logger instances
+    int threads;        ///< Number of threads logging, each owning every threads'th instance
+    int columns;        ///< Number of values per row, or tens of characters per line for SimpleLogger
+
+    /**
+     * @brief Gets the key that identifies this point in a baseline
+     *
+     * @return Comma separated fields of this point
+     */
+    QString key() const {
+        return logger + "," + policy + "," + target + "," + QString::number(instances) + "," +
+            QString::number(threads) + "," + QString::number(columns);
+    }
+};
+
+/**
+ * @brief Measurements of one point of the sweep
+ */
+struct Result {
+    qint64 rows;                ///< Rows logged
+    qint64 bytes;               ///< Bytes in the log files after closing
+    qint64 droppedRows;         ///< Rows the loggers dropped
+    double seconds;             ///< Time from the first row until all loggers are closed
+    qint64 p50Nanos;            ///< Median time spent in one log() call
+    qint64 p99Nanos;            ///< 99th percentile time spent in one log() call
+    qint64 p999Nanos;           ///< 99.9th percentile time spent in one log() call
+    qint64 maxNanos;            ///< Longest time spent in one log() call
+    double cpuCores;            ///< CPU time of the process over wall time
+    qint64 voluntarySwitches;   ///< Context switches because of blocking, e.g on locks or I/O
+    qint64 involuntarySwitches; ///< Context switches because of preemption
+    int fds;                    ///< Most file descriptors opened on top of those before the loggers, -1 if unknown
+    int tasks;                  ///< Most threads in the process, -1 if unknown
+};
+
+/**
+ * @brief Log-linear latency histogram with 16 buckets per power of two, i.e within 6.25% of the recorded value
+ */
+class LatencyHistogram {
+
+public:
+
+    /**
+     * @brief Creates an empty histogram
+     */
+    LatencyHistogram(){
+        counts.fill(0, 1024);
+        total = 0;
+        max = 0;
+    }
+
+    /**
+     * @brief Records one value
+     *
+     * @param nanos Value to record
+     */
+    void add(qint64 nanos){
+        counts[bucket(nanos)]++;
+        total++;
+        if(nanos > max)
+            max = nanos;
+    }
+
+    /**
+     * @brief Adds the values of another histogram
+     *
+     * @param other Histogram to add
+     */
+    void merge(LatencyHistogram const& other){
+        for(int i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        max = qMax(max, other.max);
+    }
+
+    /**
+     * @brief Gets the upper bound of the bucket that holds the given quantile
+     *
+     * @param quantile Quantile in [0, 1]
+     * @return Upper bound of the quantile's bucket, 0 if empty
+     */
+    qint64 quantile(double quantile) const {
+        qint64 rank = qint64(quantile*total);
+        qint64 seen = 0;
+        for(int i = 0; i < counts.size(); i++){
+            seen += counts[i];
+            if(seen > rank)
+                return qMin(upperBound(i), max);
+        }
+        return max;
+    }
+
+    /**
+     * @brief Gets the largest value recorded
+     *
+     * @return Largest value recorded
+     */
+    qint64 getMax() const { return max; }
+
+private:
+
+    QVector<qint64> counts;     ///< Number of values in each bucket
+    qint64 total;               ///< Number of values
+    qint64 max;                 ///< Largest value
+
+    /**
+     * @brief Gets the bucket of a value, values under 16 have a bucket each
+     */
+    static int bucket(qint64 nanos){
+        if(nanos < 16)
+            return int(qMax(nanos, qint64(0)));
+        int msb = 63 - qCountLeadingZeroBits(quint64(nanos));
+        return (msb - 3)*16 + int((nanos >> (msb - 4)) & 15);
+    }
+
+    /**
+     * @brief Gets the largest value that falls into a bucket
+     */
+    static qint64 upperBound(int bucket){
+        if(bucket < 16)
+            return bucket;
+        int shift = bucket/16 - 4 + 3;
+        return ((qint64(16 + bucket%16) + 1) << shift) - 1;
+    }
+};
+
+/**
+ * @brief Writes markers to the kernel's trace buffer so that they show up as ftrace:print events in perf and trace-cmd
+ */
+class TraceMarker {
+
+public:
+
+    /**
+     * @brief Opens the trace marker file if tracefs is mounted and writable
+     */
+    TraceMarker(){
+        fd = -1;
+#if defined(Q_OS_LINUX)
+        fd = ::open("/sys/kernel/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+        if(fd < 0)
+            fd = ::open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
+#endif
+    }
+
+    /**
+     * @brief Closes the trace marker file
+     */
+    ~TraceMarker(){
+#if defined(Q_OS_UNIX)
+        if(fd >= 0)
+            ::close(fd);
+#endif
+    }
+
+    /**
+     * @brief Writes a marker, does nothing if tracing is not available
+     *
+     * @param text Marker text
+     */
+    void mark(QString const& text){
+#if defined(Q_OS_UNIX)
+        if(fd >= 0){
+            QByteArray marker = "logger-stress: " + text.toUtf8();
+            if(::write(fd, marker.constData(), marker.size()) < 0)
+                return;
+        }
+#else
+        Q_UNUSED(text)
+#endif
+    }
+
+    /**
+     * @brief Gets whether markers are written
+     *
+     * @return Whether the trace marker file is open
+     */
+    bool isOpen() const { return fd >= 0; }
+
+private:
+
+    int fd;     ///< Trace marker file
+};
+
+/**
+ * @brief Counts the entries of a procfs directory, e.g the file descriptors or threads of this process
+ *
+ * @param path Directory to count the entries of
+ * @return Number of entries, -1 if there is no such directory
+ */
+int countEntries(QString const& path){
+    QDir dir(path);
+    if(!dir.exists())
+        return -1;
+    return dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System).size();
+}
+
+/**
+ * @brief CPU usage of the process
+ */
+struct Usage {
+    double cpuSeconds;          ///< User and system time
+    qint64 voluntarySwitches;   ///< Context switches because of blocking
+    qint64 involuntarySwitches; ///< Context switches because of preemption
+};
+
+/**
+ * @brief Gets the CPU usage of the process so far
+ *
+ * @return CPU usage so far, all zeroes if not supported
+ */
+Usage getUsage(){
+    Usage usage = {0, 0, 0};
+#if defined(Q_OS_UNIX)
+    struct rusage ru;
+    if(getrusage(RUSAGE_SELF, &ru) == 0){
+        usage.cpuSeconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec*1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec*1e-6;
+        usage.voluntarySwitches = ru.ru_nvcsw;
+        usage.involuntarySwitches = ru.ru_nivcsw;
+    }
+#endif
+    return usage;
+}
+
+/**
+ * @brief Parses a comma separated list of positive integers
+ *
+ * @param list List to parse
+ * @return Parsed integers, invalid entries skipped
+ */
+QList<int> parseIntegers(QString const& list){
+    QList<int> values;
+    for(QString const& entry : list.split(',', skipEmptyParts)){
+        bool ok = false;
+        int value = entry.trimmed().toInt(&ok);
+        if(ok && value > 0)
+            values << value;
+    }
+    return values;
+}
+
+/**
+ * @brief Logs with one configuration for the given duration and measures it
+ *
+ * @param config Configuration to run
+ * @param baseDir Directory to create the log directory in
+ * @param durationNanos How long to log for
+ * @param frameRows Rows each instance logs per frame
+ * @param marker Trace markers
+ * @return Measurements
+ */
+Result run(Config const& config, QString const& baseDir, qint64 durationNanos, int frameRows, TraceMarker& marker){
+    QTemporaryDir dir(baseDir + "/logger-stress-XXXXXX");
+    bool csv = config.logger == "csv";
+    bool flushFrames = config.policy == "frame" || config.policy == "async-frame";
+    int fdsBefore = countEntries("/proc/self/fd");
+
+    //Create and open all loggers with one row each before the clock starts, opening is not what is measured
+    QList<QString> header;
+    QVariantList values;
+    QString line;
+    for(int i = 0; i < config.columns; i++){
+        header << "column" + QString::number(i);
+        values << 1234.5678*(i + 1);
+        line += "value " + QString::number(1000 + i) + ", ";
+    }
+    std::vector<CSVLogger*> csvLoggers;
+    std::vector<SimpleLogger*> simpleLoggers;
+    for(int i = 0; i < config.instances; i++){
+        QString filename = dir.path() + "/" + (config.target == "file" ? QString("shared") : QString::number(i)) + (csv ? ".csv" : ".log");
+        if(csv){
+            CSVLogger* logger = new CSVLogger();
+            logger->setHeader(header);
+            logger->setAsynchronous(config.policy == "async" || config.policy == "async-frame");
+            logger->setCoalesce(flushFrames ? CSVLogger::CoalesceEventLoop : CSVLogger::CoalesceNone);
+            logger->setFilename(filename);
+            logger->log(values);
+            logger->flush();
+            csvLoggers.push_back(logger);
+        }
+        else{
+            SimpleLogger* logger = new SimpleLogger();
+            logger->setFilename(filename);
+            logger->log(line);
+            simpleLoggers.push_back(logger);
+        }
+    }
+
+    std::vector<LatencyHistogram> histograms(config.threads);
+    std::atomic<bool> go(false);
+    std::atomic<int> finished(0);
+    std::atomic<qint64> rows(0);
+    QElapsedTimer clock;
+
+    //Every thread owns every threads'th instance, instances are never logged to from more than one thread
+    std::vector<std::thread> threads;
+    for(int t = 0; t < config.threads; t++){
+        threads.push_back(std::thread([&, t](){
+            LatencyHistogram& histogram = histograms[t];
+            qint64 logged = 0;
+            qint64 frame = 0;
+            while(!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            //The time spent in flush() is counted in the latency of the next row, like a frame would see it
+            qint64 previous = clock.nsecsElapsed();
+            while(previous < durationNanos){
+                STRESS_PROBE(frame_begin, t, frame);
+                for(int i = t; i < config.instances; i += config.threads){
+                    for(int r = 0; r < frameRows; r++){
+                        if(csv)
+                            csvLoggers[i]->log(values);
+                        else
+                            simpleLoggers[i]->log(line);
+                        qint64 now = clock.nsecsElapsed();
+                        histogram.add(now - previous);
+                        previous = now;
+                    }
+                    if(flushFrames)
+                        csvLoggers[i]->flush();
+                    logged += frameRows;
+                }
+                STRESS_PROBE(frame_end, t, logged);
+                frame++;
+            }
+            rows += logged;
+            finished++;
+        }));
+    }
+
+    marker.mark("begin " + config.key());
+    Usage before = getUsage();
+    clock.start();
+    go.store(true, std::memory_order_release);
+
+    //Sample the descriptors and threads while logging, asynchronous loggers add both
+    int fds = fdsBefore;
+    int tasks = countEntries("/proc/self/task");
+    while(finished.load() < config.threads){
+        QThread::msleep(10);
+        fds = qMax(fds, countEntries("/proc/self/fd"));
+        tasks = qMax(tasks, countEntries("/proc/self/task"));
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    //Closing drains the coalesced rows and the writer threads, which is part of the throughput
+    marker.mark("close " + config.key());
+    Result result;
+    result.droppedRows = 0;
+    for(CSVLogger* logger : csvLoggers){
+        logger->close();
+        result.droppedRows += logger->getDroppedRows();
+        delete logger;
+    }
+    for(SimpleLogger* logger : simpleLoggers)
+        delete logger;
+    result.seconds = clock.nsecsElapsed()*1e-9;
+    Usage after = getUsage();
+    marker.mark("end " + config.key());
+
+    LatencyHistogram histogram;
+    for(LatencyHistogram const& threadHistogram : histograms)
+        histogram.merge(threadHistogram);
+    result.rows = rows.load();
+    result.bytes = 0;
+    QDirIterator files(dir.path(), QDir::Files);
+    while(files.hasNext()){
+        files.next();
+        result.bytes += files.fileInfo().size();
+    }
+    result.p50Nanos = histogram.quantile(0.5);
+    result.p99Nanos = histogram.quantile(0.99);
+    result.p999Nanos = histogram.quantile(0.999);
+    result.maxNanos = histogram.getMax();
+    result.cpuCores = (after.cpuSeconds - before.cpuSeconds)/result.seconds;
+    result.voluntarySwitches = after.voluntarySwitches - before.voluntarySwitches;
+    result.involuntarySwitches = after.involuntarySwitches - before.involuntarySwitches;
+    result.fds = fdsBefore < 0 ? -1 : fds - fdsBefore;
+    result.tasks = tasks;
+    return result;
+}
+
+/**
+ * @brief Reads the rows per second and p99 latency of every point of an earlier run's results
+ *
+ * @param filename Results of an earlier run
+ * @param baseline Filled with the rows per second and p99 latency of every point
+ * @return Whether the file could be read
+ */
+bool readBaseline(QString const& filename, QHash<QString, QPair<double, double>>& baseline){
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    file.readLine(); //Header
+    while(!file.atEnd()){
+        QList<QByteArray> fields = file.readLine().trimmed().split(',');
+        if(fields.size() < 13)
+            continue;
+        QString key;
+        for(int i = 0; i < 6; i++)
+            key += (i > 0 ? "," : "") + QString::fromUtf8(fields[i]);
+        baseline.insert(key, qMakePair(fields[9].toDouble(), fields[12].toDouble()));
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[]){
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Logs from many logger instances and threads at once and measures throughput, latency and resource usage.");
+    parser.addHelpOption();
+    QCommandLineOption loggersOption("loggers", "Comma separated loggers to sweep, csv and/or simple, default csv,simple.", "list", "csv,simple");
+    QCommandLineOption policiesOption("policies", "Comma separated CSVLogger flush policies to sweep: row, frame, async, async-frame, default row,frame,async.", "list", "row,frame,async");
+    QCommandLineOption targetsOption("targets", "Comma separated targets to sweep: directory for one file per instance, file for one shared file, default directory,file.", "list", "directory,file");
+    QCommandLineOption instancesOption(QStringList() << "i" << "instances", "Comma separated instance counts to sweep, default 1,10,100,1000.", "list", "1,10,100,1000");
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads", "Comma separated thread counts to sweep, default 1,4.", "list", "1,4");
+    QCommandLineOption columnsOption(QStringList() << "c" << "columns", "Comma separated row sizes in columns to sweep, default 8.", "list", "8");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Log for <seconds> per point, default 1.", "seconds", "1");
+    QCommandLineOption frameRowsOption("frame-rows", "Log <n> rows per instance per frame, default 4.", "n", "4");
+    QCommandLineOption dirOption("dir", "Log into temporary directories in <dir>, default the system's temporary directory.", "dir", QDir::tempPath());
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Also write the results to <file>.", "file");
+    QCommandLineOption baselineOption(QStringList() << "b" << "baseline", "Compare against the results of an earlier run in <file> and fail on regressions.", "file");
+    QCommandLineOption toleranceOption("tolerance", "Allowed drop of rows per second against the baseline, default 0.2.", "fraction", "0.2");
+    QCommandLineOption latencyToleranceOption("latency-tolerance", "Allowed rise of p99 latency against the baseline, default 0.5.", "fraction", "0.5");
+    parser.addOption(loggersOption);
+    parser.addOption(policiesOption);
+    parser.addOption(targetsOption);
+    parser.addOption(instancesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(columnsOption);
+    parser.addOption(durationOption);
+    parser.addOption(frameRowsOption);
+    parser.addOption(dirOption);
+    parser.addOption(outputOption);
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(latencyToleranceOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+    QStringList loggers = parser.value(loggersOption).split(',', skipEmptyParts);
+    QStringList policies = parser.value(policiesOption).split(',', skipEmptyParts);
+    QStringList targets = parser.value(targetsOption).split(',', skipEmptyParts);
+    QList<int> instanceCounts = parseIntegers(parser.value(instancesOption));
+    QList<int> threadCounts = parseIntegers(parser.value(threadsOption));
+    QList<int> columnCounts = parseIntegers(parser.value(columnsOption));
+    qint64 durationNanos = qint64(qMax(0.01, parser.value(durationOption).toDouble())*1e9);
+    int frameRows = qMax(1, parser.value(frameRowsOption).toInt());
+    double tolerance = parser.value(toleranceOption).toDouble();
+    double latencyTolerance = parser.value(latencyToleranceOption).toDouble();
+
+    QHash<QString, QPair<double, double>> baseline;
+    if(parser.isSet(baselineOption) && !readBaseline(parser.value(baselineOption), baseline)){
+        err << "Cannot read baseline " << parser.value(baselineOption) << "\n";
+        return 1;
+    }
+
+    QFile outputFile;
+    if(parser.isSet(outputOption)){
+        outputFile.setFileName(parser.value(outputOption));
+        if(!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)){
+            err << "Cannot open " << outputFile.fileName() << " for writing" << "\n";
+            return 1;
+        }
+    }
+
+#if defined(Q_OS_UNIX)
+    //A thousand instances need a thousand descriptors on top of the usual ones
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+
+    TraceMarker marker;
+    if(!marker.isOpen())
+        err << "Trace markers disabled, tracefs' trace_marker is not writable" << "\n";
+    err.flush();
+
+    QTextStream out(stdout);
+    QTextStream fileOut(&outputFile);
+    QString header = "logger,policy,target,instances,threads,columns,rows,seconds,bytes,rowsPerSecond,megabytesPerSecond,"
+        "p50Nanos,p99Nanos,p999Nanos,maxNanos,cpuCores,voluntarySwitches,involuntarySwitches,droppedRows,fds,tasks";
+    out << header << "\n";
+    out.flush();
+    if(outputFile.isOpen())
+        fileOut << header << "\n";
+
+    int regressions = 0;
+    for(QString const& logger : loggers){
+        for(QString const& policy : policies){
+
+            //SimpleLogger writes every line as it comes
+            if(logger == "simple" && policy != "row")
+                continue;
+            for(QString const& target : targets){
+                for(int instances : instanceCounts){
+                    QList<int> seenThreads;
+                    for(int threads : threadCounts){
+                        Config config = {logger, policy, target, instances, qMin(threads, instances), 0};
+                        if(seenThreads.contains(config.threads))
+                            continue;
+                        seenThreads << config.threads;
+                        for(int columns : columnCounts){
+                            config.columns = columns;
+                            Result result = run(config, parser.value(dirOption), durationNanos, frameRows, marker);
+
+                            double rowsPerSecond = result.rows/result.seconds;
+                            QString line = config.key() + "," +
+                                QString::number(result.rows) + "," +
+                                QString::number(result.seconds, 'f', 3) + "," +
+                                QString::number(result.bytes) + "," +
+                                QString::number(rowsPerSecond, 'f', 0) + "," +
+                                QString::number(result.bytes/result.seconds/(1024*1024), 'f', 2) + "," +
+                                QString::number(result.p50Nanos) + "," +
+                                QString::number(result.p99Nanos) + "," +
+                                QString::number(result.p999Nanos) + "," +
+                                QString::number(result.maxNanos) + "," +
+                                QString::number(result.cpuCores, 'f', 2) + "," +
+                                QString::number(result.voluntarySwitches) + "," +
+                                QString::number(result.involuntarySwitches) + "," +
+                                QString::number(result.droppedRows) + "," +
+                                QString::number(result.fds) + "," +
+                                QString::number(result.tasks);
+                            out << line << "\n";
+                            out.flush();
+                            if(outputFile.isOpen())
+                                fileOut << line << "\n";
+
+                            if(baseline.contains(config.key())){
+                                QPair<double, double> expected = baseline.value(config.key());
+                                if(rowsPerSecond < expected.first*(1 - tolerance)){
+                                    err << "Regression in " << config.key() << ": " << QString::number(rowsPerSecond, 'f', 0)
+                                        << " rows/s, baseline " << QString::number(expected.first, 'f', 0) << " rows/s" << "\n";
+                                    regressions++;
+                                }
+                                if(result.p99Nanos > expected.second*(1 + latencyTolerance)){
+                                    err << "Regression in " << config.key() << ": p99 " << result.p99Nanos << " ns, baseline "
+                                        << QString::number(expected.second, 'f', 0) << " ns" << "\n";
+                                    regressions++;
+                                }
+                                err.flush();
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if(regressions > 0){
+        err << regressions << " regression(s) against the baseline" << "\n";
+        return 1;
+    }
+    return 0;
+}